@@ -0,0 +1,376 @@
+#include "AutoTuner.h"
+#include "Mandlebrot.h"
+#include "NumaThreadPool.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+using std::cout;
+using std::endl;
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// CONSTRUCTOR / DESTRUCTOR
+AutoTuner::AutoTuner(Mandlebrot* mandle, MyAMP* amp, const char* configFile)
+{
+	this->mandle = mandle;
+	this->amp = amp;
+	this->configFile = configFile;
+}
+
+AutoTuner::~AutoTuner()
+{
+
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// FUNCTIONS
+
+// Everything worth trying on this machine. The current defaults from Mandlebrot.h are always in the list.
+std::vector<TunedConfig> AutoTuner::candidates()
+{
+	const CpuCapabilities& cpu = amp->getCpuCapabilities();
+
+	// All the hardware threads, one per core if hyper threading makes things worse, or half if memory is the limit.
+	std::vector<int> threadCounts = { std::max(1, cpu.logicalProcessors), std::max(1, cpu.physicalCores), std::max(1, cpu.logicalProcessors / 2) };
+	std::sort(threadCounts.begin(), threadCounts.end());
+	threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+	const int tileRows[] = { 4, FUSED_COUNT_ROWS, NUMA_STRIPE_ROWS, 64 };
+	const char* blurs[] = { "separate", "fused" };
+
+	std::vector<TunedConfig> configs;
+
+	for (const char* blur : blurs)
+	{
+		for (int threads : threadCounts)
+		{
+			for (int rows : tileRows)
+			{
+				TunedConfig config;
+				config.backend = "cpu";
+				config.blur = blur;
+				config.numThreads = threads;
+				config.tileRows = rows;
+				config.timeMs = 0;
+
+				configs.push_back(config);
+			}
+		}
+	}
+
+	// The emulated accelerators are far slower than the CPU backend, not worth the time.
+	if (amp->hasHardwareAccelerator())
+	{
+		TunedConfig config;
+		config.backend = "amp";
+		config.blur = "separate";
+		config.numThreads = 0;
+		config.tileRows = 0;
+		config.timeMs = 0;
+
+		configs.push_back(config);
+	}
+
+	return configs;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Render name with config, blurred like a normal run. Returns the time taken in ms, or -1 on failure.
+// The sweep passes false for writeImage so the time is just the render and not the disk.
+long long AutoTuner::run(const TunedConfig& config, const std::string& name, bool writeImage)
+{
+	const FractalVariant* variant = FractalRegistry::findOrList(name);
+
+	if (!variant)
+	{
+		return -1;
+	}
+
+	if (config.backend == "amp")
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		mandle->compute_fractal_compact(name, variant->left, variant->right, variant->top, variant->bottom, true, false, writeImage);
+
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+		return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+	}
+
+	// Made before the clock starts so starting and pinning the pool's threads isn't timed.
+	NumaThreadPool pool(config.numThreads);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	if (config.blur == "fused")
+	{
+		mandle->compute_fractal_fused(&pool, name, variant->left, variant->right, variant->top, variant->bottom, true, "fused_image.tga", config.tileRows, writeImage);
+	}
+	else
+	{
+		mandle->compute_fractal_numa(&pool, name, variant->left, variant->right, variant->top, variant->bottom, true, config.tileRows, writeImage);
+	}
+
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Try every candidate on name, save the fastest to configFile and return it.
+TunedConfig AutoTuner::tune(const std::string& name)
+{
+	const FractalVariant* variant = FractalRegistry::find(name);
+	std::vector<TunedConfig> configs = candidates();
+	TunedConfig best = configs[0];
+	best.timeMs = -1;
+
+	for (TunedConfig& config : configs)
+	{
+		config.fractal = name;
+		config.maxIterations = variant ? variant->maxIterations : 0;
+		config.countsPerWord = variant ? variant->countsPerWord : 0;
+		config.timeMs = -1;
+
+		for (int i = 0; i < TUNE_REPEATS; ++i)
+		{
+			long long time = run(config, name, false);
+
+			if (time >= 0 && (config.timeMs < 0 || time < config.timeMs))
+			{
+				config.timeMs = time;
+			}
+		}
+
+		cout << "Tuning: backend=" << config.backend << " blur=" << config.blur << " threads=" << config.numThreads
+			<< " tile_rows=" << config.tileRows << " took " << config.timeMs << " ms" << endl;
+
+		if (config.timeMs >= 0 && (best.timeMs < 0 || config.timeMs < best.timeMs))
+		{
+			best = config;
+		}
+	}
+
+	cout << "Fastest: backend=" << best.backend << " blur=" << best.blur << " threads=" << best.numThreads
+		<< " tile_rows=" << best.tileRows << " at " << best.timeMs << " ms" << endl;
+
+	if (best.timeMs >= 0)
+	{
+		saveConfig(best);
+	}
+
+	return best;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// What the config file was tuned on, if any of this changes the settings probably don't hold any more.
+std::string AutoTuner::machineSignature()
+{
+	const CpuCapabilities& cpu = amp->getCpuCapabilities();
+
+	return cpu.brand + "|" + std::to_string(cpu.logicalProcessors) + "|" + std::to_string(cpu.numaNodes)
+		+ "|" + (amp->hasHardwareAccelerator() ? "amp" : "no amp");
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// One key=value per line, written so it's easy to read or edit by hand. Each fractal gets its own section,
+// starting at its fractal= line, so tuning one doesn't throw away the settings for the others.
+bool AutoTuner::saveConfig(const TunedConfig& config)
+{
+	std::vector<TunedConfig> configs;
+	readConfigs(configs);
+
+	// Replace the section for the same fractal, name and the amount of work per pixel both have to match.
+	configs.erase(std::remove_if(configs.begin(), configs.end(), [&](const TunedConfig& other)
+		{
+			return other.fractal == config.fractal && other.maxIterations == config.maxIterations && other.countsPerWord == config.countsPerWord;
+		}), configs.end());
+
+	configs.push_back(config);
+
+	std::ofstream outfile(configFile);
+
+	outfile << "# Written by the autotuner, delete this file (or one fractal's section) to tune again." << '\n';
+	outfile << "machine=" << machineSignature() << '\n';
+
+	for (const TunedConfig& saved : configs)
+	{
+		outfile << '\n';
+		outfile << "fractal=" << saved.fractal << '\n';
+		outfile << "max_iterations=" << saved.maxIterations << '\n';
+		outfile << "counts_per_word=" << saved.countsPerWord << '\n';
+		outfile << "backend=" << saved.backend << '\n';
+		outfile << "blur=" << saved.blur << '\n';
+		outfile << "threads=" << saved.numThreads << '\n';
+		outfile << "tile_rows=" << saved.tileRows << '\n';
+		outfile << "time_ms=" << saved.timeMs << '\n';
+	}
+
+	outfile.close();
+	if (!outfile)
+	{
+		// An error has occurred at some point since we opened the file.
+		cout << "Error writing to " << configFile << endl;
+		return false;
+	}
+
+	cout << "Saved tuned settings for " << config.fractal << " to " << configFile << endl;
+
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Every section in the config file. Returns false, with configs empty, if there's no file or it was tuned on another machine.
+bool AutoTuner::readConfigs(std::vector<TunedConfig>& configs)
+{
+	configs.clear();
+
+	std::ifstream infile(configFile);
+
+	if (!infile)
+	{
+		return false;
+	}
+
+	std::string machine;
+	std::string line;
+
+	while (std::getline(infile, line))
+	{
+		size_t equals = line.find('=');
+
+		if (line.empty() || line[0] == '#' || equals == std::string::npos)
+		{
+			continue;
+		}
+
+		std::string key = line.substr(0, equals);
+		std::string value = line.substr(equals + 1);
+
+		if (key == "machine")
+		{
+			machine = value;
+			continue;
+		}
+
+		if (key == "fractal")
+		{
+			TunedConfig config;
+			config.fractal = value;
+			config.maxIterations = 0;
+			config.countsPerWord = 0;
+			config.numThreads = 0;
+			config.tileRows = 0;
+			config.timeMs = -1;
+
+			configs.push_back(config);
+			continue;
+		}
+
+		// Anything before the first fractal= line doesn't belong to a section.
+		if (configs.empty())
+		{
+			continue;
+		}
+
+		TunedConfig& config = configs.back();
+
+		if (key == "max_iterations")
+		{
+			config.maxIterations = atoi(value.c_str());
+		}
+		else if (key == "counts_per_word")
+		{
+			config.countsPerWord = atoi(value.c_str());
+		}
+		else if (key == "backend")
+		{
+			config.backend = value;
+		}
+		else if (key == "blur")
+		{
+			config.blur = value;
+		}
+		else if (key == "threads")
+		{
+			config.numThreads = atoi(value.c_str());
+		}
+		else if (key == "tile_rows")
+		{
+			config.tileRows = atoi(value.c_str());
+		}
+		else if (key == "time_ms")
+		{
+			config.timeMs = atoll(value.c_str());
+		}
+	}
+
+	if (machine != machineSignature())
+	{
+		cout << configFile << " was tuned on different hardware, ignoring it" << endl;
+		configs.clear();
+		return false;
+	}
+
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Returns false if there's no config file, it was tuned on another machine, it has no section for name, or it doesn't make sense.
+bool AutoTuner::loadConfig(const std::string& name, TunedConfig& config)
+{
+	std::vector<TunedConfig> configs;
+
+	if (!readConfigs(configs))
+	{
+		return false;
+	}
+
+	// MAX_ITERATIONS or the packing may have been changed since, that's a different amount of work even for the same name.
+	const FractalVariant* variant = FractalRegistry::find(name);
+	bool found = false;
+
+	for (const TunedConfig& saved : configs)
+	{
+		if (variant && saved.fractal == name && saved.maxIterations == variant->maxIterations && saved.countsPerWord == variant->countsPerWord)
+		{
+			config = saved;
+			found = true;
+		}
+	}
+
+	if (!found)
+	{
+		cout << configFile << " has no settings for " << name << " yet" << endl;
+		return false;
+	}
+
+	bool validAmp = (config.backend == "amp") && amp->hasHardwareAccelerator();
+	bool validCpu = (config.backend == "cpu") && (config.blur == "separate" || config.blur == "fused")
+		&& config.numThreads > 0 && config.tileRows > 0;
+
+	if (!validAmp && !validCpu)
+	{
+		cout << configFile << " doesn't hold a usable configuration for " << name << ", ignoring it" << endl;
+		return false;
+	}
+
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,66 @@
+#pragma once
+#include "FractalRegistry.h"
+#include "MyAMP.h"
+#include <string>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Where the winning configuration for each fractal is kept between runs, delete it to tune again.
+const char* const TUNED_CONFIG_FILE = "tuned_config.txt";
+
+// How many times each configuration is rendered during the sweep, only the fastest run counts.
+const int TUNE_REPEATS = 2;
+
+class Mandlebrot;
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// One configuration tried by the sweep, the fastest one is what gets saved.
+struct TunedConfig
+{
+	std::string fractal;	// What it was tuned on, along with the two below. A different fractal can be a lot more or less work per row.
+	int maxIterations;
+	int countsPerWord;
+	std::string backend;	// "amp" for the accelerator, "cpu" for the NUMA thread pool.
+	std::string blur;		// "separate" blurs once the whole frame is rendered, "fused" blurs band by band (cpu only).
+	int numThreads;			// Ignored by the amp backend.
+	int tileRows;			// Rows per stripe when separate, rows of counts per step when fused. Ignored by the amp backend.
+	long long timeMs;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Picks the fastest way to render on this machine instead of relying on the constants in Mandlebrot.h.
+ *
+ * The sweep renders the same blurred image with every combination of backend, tile size, thread count
+ * and blur variant that makes sense for the hardware MyAMP found, and saves the fastest to configFile.
+ * Only the render is timed, the sweep never writes the image out.
+ * The file is stamped with the CPU and accelerator it was tuned on, so copying it to a different
+ * machine just means it gets tuned again rather than run with someone else's settings.
+ * It holds one section per fractal (and MaxIter and packing), tuning another fractal adds to it.
+ */
+class AutoTuner
+{
+public:
+	AutoTuner(Mandlebrot* mandle, MyAMP* amp, const char* configFile = TUNED_CONFIG_FILE);
+	~AutoTuner();
+
+	TunedConfig tune(const std::string& name);
+	long long run(const TunedConfig& config, const std::string& name, bool writeImage = true);
+	bool loadConfig(const std::string& name, TunedConfig& config);
+	bool saveConfig(const TunedConfig& config);
+
+private:
+	std::vector<TunedConfig> candidates();
+	bool readConfigs(std::vector<TunedConfig>& configs);
+	std::string machineSignature();
+
+	Mandlebrot* mandle;
+	MyAMP* amp;
+	std::string configFile;
+
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////
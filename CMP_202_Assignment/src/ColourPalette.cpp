@@ -73,6 +73,63 @@ std::vector<Colour> ColourPalette::createPalette()
 
 /////////////////////////////////////////////////////////////////////////////////////////////
 
+// One colour per iteration count, used when colouring is done after the kernel instead of inside it.
+// Matches the colouring in the kernel, the last count is black and anything past the palette wraps around.
+std::vector<Colour> ColourPalette::createIterationLUT(int maxIterations)
+{
+	std::vector<Colour> palette = createPalette();
+	std::vector<Colour> lut(maxIterations);
+
+	for (int i = 0; i < maxIterations - 1; ++i)
+	{
+		lut[i] = palette[i % palette.size()];
+	}
+
+	// Points that never escaped.
+	lut[maxIterations - 1] = Colour{ 0.0f, 0.0f, 0.0f };
+
+	return lut;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Histogram equalised version of createIterationLUT.
+// Instead of count i getting palette[i], it gets the palette entry at the same fraction of the way through
+// the palette as the fraction of escaped pixels that took i iterations or fewer (the CDF).
+// This spreads the colours over the iteration counts that actually appear in the image.
+std::vector<Colour> ColourPalette::createEqualisedLUT(const std::vector<int>& histogram)
+{
+	std::vector<Colour> palette = createPalette();
+	int maxIterations = (int)histogram.size();
+	std::vector<Colour> lut(maxIterations);
+
+	// The last bin is the points that never escaped, they stay black and don't count towards the CDF.
+	long long totalEscaped = 0;
+
+	for (int i = 0; i < maxIterations - 1; ++i)
+	{
+		totalEscaped += histogram[i];
+	}
+
+	long long runningTotal = 0;
+
+	for (int i = 0; i < maxIterations - 1; ++i)
+	{
+		runningTotal += histogram[i];
+
+		double cdf = (totalEscaped > 0) ? double(runningTotal) / double(totalEscaped) : 0.0;
+		int palIdx = int(cdf * (palette.size() - 1));
+
+		lut[i] = palette[palIdx];
+	}
+
+	lut[maxIterations - 1] = Colour{ 0.0f, 0.0f, 0.0f };
+
+	return lut;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
 // GETTERS / SETTERS
 double ColourPalette::getColourPalSize()
 {
@@ -20,6 +20,8 @@ public:
 
 	Colour rgb(double ratio);
 	std::vector<Colour> createPalette();
+	std::vector<Colour> createIterationLUT(int maxIterations);
+	std::vector<Colour> createEqualisedLUT(const std::vector<int>& histogram);
 	double getColourPalSize();
 
 	double colourPaletteSize;
@@ -0,0 +1,294 @@
+#include "ColourPipeline.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// HELPERS
+
+// Round a blurred channel back to a byte, the filter weights don't sum to exactly 1 so clamp as well.
+static uint8_t toByte(float channel)
+{
+	float rounded = channel + 0.5f;
+
+	if (rounded <= 0.0f)
+	{
+		return 0;
+	}
+
+	if (rounded >= 255.0f)
+	{
+		return 255;
+	}
+
+	return (uint8_t)rounded;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// CONSTRUCTOR / DESTRUCTOR
+ColourPipeline::ColourPipeline(int width, int height, const std::vector<Colour>& iterationLUT, int countsPerWord, bool blur)
+{
+	this->width = width;
+	this->height = height;
+	this->countsPerWord = countsPerWord;
+	this->blur = blur;
+	bitsPerCount = 32 / countsPerWord;
+	lut = iterationLUT;
+
+	paddedRow.resize((width + KERNEL_SIZE - 1) * 3);
+	ring.resize(KERNEL_SIZE * width * 3);
+	accumRow.resize(width * 3);
+	bgrRow.resize(width * 3);
+
+	setRowRange(0, height);
+}
+
+ColourPipeline::~ColourPipeline()
+{
+
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// FUNCTIONS
+
+// Only produce rows [firstRow, endRow) of the image, this has to be called before the first row is pushed.
+void ColourPipeline::setRowRange(int firstRow, int endRow)
+{
+	this->firstRow = firstRow;
+	this->endRow = endRow;
+
+	nextInputRow = getFirstInputRow();
+	nextOutputRow = firstRow;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Same header as Mandlebrot::write_tga, but for any size of image.
+// Static as it doesn't need a pipeline, code that puts rows together from several pipelines writes it itself.
+// Format specification: http://www.gamers.org/dEngine/quake3/TGA.txt
+void ColourPipeline::writeHeader(std::ostream& out, int width, int height)
+{
+	uint8_t header[18] = {
+		0, // no image ID
+		0, // no colour map
+		2, // uncompressed 24-bit image
+		0, 0, 0, 0, 0, // empty colour map specification
+		0, 0, // X origin
+		0, 0, // Y origin
+		(uint8_t)(width & 0xFF), (uint8_t)((width >> 8) & 0xFF), // width
+		(uint8_t)(height & 0xFF), (uint8_t)((height >> 8) & 0xFF), // height
+		24, // bits per pixel
+		0, // image descriptor
+	};
+	out.write((const char*)header, 18);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Unpack a row of iteration counts and look each one up in the LUT, giving 3 floats per pixel (r, g, b).
+void ColourPipeline::colourRow(const uint32_t* packedRow, float* rgbOut)
+{
+	const uint32_t countMask = (1u << bitsPerCount) - 1;
+	const int lastCount = (int)lut.size() - 1;
+	int x = 0;
+
+	for (int w = 0; x < width; ++w)
+	{
+		uint32_t word = packedRow[w];
+
+		for (int i = 0; i < countsPerWord && x < width; ++i, ++x)
+		{
+			int count = std::min((int)(word & countMask), lastCount);
+			word >>= bitsPerCount;
+
+			rgbOut[x * 3 + 0] = lut[count].colChannel_1;
+			rgbOut[x * 3 + 1] = lut[count].colChannel_2;
+			rgbOut[x * 3 + 2] = lut[count].colChannel_3;
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// rgbIn has KERNEL_SIZE / 2 extra pixels either side, so there is no bounds checking in the inner loop.
+void ColourPipeline::blurHorizontal(const float* rgbIn, float* rgbOut)
+{
+	for (int x = 0; x < width; ++x)
+	{
+		float red = 0.0f;
+		float green = 0.0f;
+		float blue = 0.0f;
+
+		// rgbIn[x] is the left most pixel of the filter for output pixel x.
+		const float* pSrc = rgbIn + (x * 3);
+
+		for (int i = 0; i < KERNEL_SIZE; ++i)
+		{
+			red += pSrc[i * 3 + 0] * wrapper.filter[i];
+			green += pSrc[i * 3 + 1] * wrapper.filter[i];
+			blue += pSrc[i * 3 + 2] * wrapper.filter[i];
+		}
+
+		rgbOut[x * 3 + 0] = red;
+		rgbOut[x * 3 + 1] = green;
+		rgbOut[x * 3 + 2] = blue;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Where row y lives in the ring of horizontally blurred rows.
+float* ColourPipeline::ringRow(int y)
+{
+	return &ring[(y % KERNEL_SIZE) * width * 3];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+void ColourPipeline::pushRow(const uint32_t* packedRow, std::ostream& out)
+{
+	push(packedRow, &out, nullptr);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+void ColourPipeline::pushRow(const uint32_t* packedRow, uint8_t* bgrRows)
+{
+	push(packedRow, nullptr, bgrRows);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Flush out the rows at the bottom of the range that were waiting on rows below them.
+void ColourPipeline::finish(std::ostream& out)
+{
+	flush(&out, nullptr);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+void ColourPipeline::finish(uint8_t* bgrRows)
+{
+	flush(nullptr, bgrRows);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Rows must be pushed in order, starting at getFirstInputRow() and stopping before getEndInputRow().
+void ColourPipeline::push(const uint32_t* packedRow, std::ostream* out, uint8_t* bgrRows)
+{
+	if (!blur)
+	{
+		// Nothing to wait for, colour it and write it straight out.
+		colourRow(packedRow, accumRow.data());
+		++nextInputRow;
+		emitRow(nextOutputRow++, out, bgrRows);
+		return;
+	}
+
+	const int radius = KERNEL_SIZE / 2;
+	float* pCentre = &paddedRow[radius * 3];
+
+	colourRow(packedRow, pCentre);
+
+	// Clamp to the edge, copy the first and last pixel out in to the padding.
+	for (int i = 0; i < radius; ++i)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			paddedRow[i * 3 + c] = pCentre[c];
+			paddedRow[(radius + width + i) * 3 + c] = pCentre[(width - 1) * 3 + c];
+		}
+	}
+
+	blurHorizontal(paddedRow.data(), ringRow(nextInputRow));
+	++nextInputRow;
+
+	// Row y can only be finished once row y + radius has been blurred horizontally.
+	while (nextOutputRow < endRow && nextOutputRow + radius < nextInputRow)
+	{
+		emitRow(nextOutputRow++, out, bgrRows);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+void ColourPipeline::flush(std::ostream* out, uint8_t* bgrRows)
+{
+	while (nextOutputRow < endRow && nextOutputRow < nextInputRow)
+	{
+		emitRow(nextOutputRow++, out, bgrRows);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Vertical blur (if on) and BGR packing for row y, then send it wherever it's going.
+void ColourPipeline::emitRow(int y, std::ostream* out, uint8_t* bgrRows)
+{
+	if (blur)
+	{
+		const int radius = KERNEL_SIZE / 2;
+		const int lastRow = std::min(height, nextInputRow) - 1;
+
+		std::fill(accumRow.begin(), accumRow.end(), 0.0f);
+
+		// Go down the filter a whole row at a time so the inner loop just streams along two rows.
+		for (int i = 0; i < KERNEL_SIZE; ++i)
+		{
+			int srcY = std::min(std::max(y - radius + i, 0), lastRow);
+			const float* pSrc = ringRow(srcY);
+			float weight = wrapper.filter[i];
+
+			for (int j = 0; j < width * 3; ++j)
+			{
+				accumRow[j] += pSrc[j] * weight;
+			}
+		}
+	}
+
+	// Straight in to the callers memory if we have it, saves a copy.
+	uint8_t* pBgr = bgrRows ? bgrRows + ((size_t)(y - firstRow) * width * 3) : bgrRow.data();
+
+	// accumRow holds r, g, b but TGA wants b, g, r.
+	for (int x = 0; x < width; ++x)
+	{
+		pBgr[x * 3 + 0] = toByte(accumRow[x * 3 + 2]);	// blue channel
+		pBgr[x * 3 + 1] = toByte(accumRow[x * 3 + 1]);	// green channel
+		pBgr[x * 3 + 2] = toByte(accumRow[x * 3 + 0]);	// red channel
+	}
+
+	if (out)
+	{
+		out->write((const char*)pBgr, width * 3);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// GETTERS / SETTERS
+int ColourPipeline::getWordsPerRow()
+{
+	return (width + countsPerWord - 1) / countsPerWord;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// With the blur on we need KERNEL_SIZE / 2 rows above and below the range, as long as they're in the image.
+int ColourPipeline::getFirstInputRow()
+{
+	return blur ? std::max(firstRow - (KERNEL_SIZE / 2), 0) : firstRow;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+int ColourPipeline::getEndInputRow()
+{
+	return blur ? std::min(endRow + (KERNEL_SIZE / 2), height) : endRow;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,74 @@
+#pragma once
+#include "ColourPalette.h"
+#include "Filter.h"
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Takes rows of packed iteration counts (see CountPacking in FractalKernels.h) and turns them
+ * in to finished 24 bit TGA rows in one streaming pass: colour lookup, horizontal blur,
+ * vertical blur and BGR packing all happen per row as it's pushed in.
+ *
+ * Only the last KERNEL_SIZE rows of colour are ever kept, so the memory used depends on
+ * the width of the image and not the height. Edges are clamped, so the border pixels
+ * are blurred with copies of themselves rather than reading off the end of the image.
+ *
+ * By default the whole image goes through one pipeline. With setRowRange a pipeline only
+ * produces some of the rows, the rows it wants pushed then include KERNEL_SIZE / 2 halo rows
+ * either side, which lets several pipelines work on different bands of the image at once.
+ */
+class ColourPipeline
+{
+public:
+	ColourPipeline(int width, int height, const std::vector<Colour>& iterationLUT, int countsPerWord, bool blur);
+	~ColourPipeline();
+
+	static void writeHeader(std::ostream& out, int width, int height);
+	void setRowRange(int firstRow, int endRow);
+
+	// Finished rows either go straight to a file, or in to memory starting at the first row of the range.
+	void pushRow(const uint32_t* packedRow, std::ostream& out);
+	void pushRow(const uint32_t* packedRow, uint8_t* bgrRows);
+	void finish(std::ostream& out);
+	void finish(uint8_t* bgrRows);
+
+	// GETTERS / SETTERS
+	int getWordsPerRow();
+	int getFirstInputRow();
+	int getEndInputRow();
+
+private:
+	void push(const uint32_t* packedRow, std::ostream* out, uint8_t* bgrRows);
+	void flush(std::ostream* out, uint8_t* bgrRows);
+	void colourRow(const uint32_t* packedRow, float* rgbOut);
+	void blurHorizontal(const float* rgbIn, float* rgbOut);
+	void emitRow(int y, std::ostream* out, uint8_t* bgrRows);
+	float* ringRow(int y);
+
+	int width;
+	int height;
+	int countsPerWord;
+	int bitsPerCount;
+	bool blur;
+
+	Filter wrapper;
+	std::vector<Colour> lut;
+
+	std::vector<float> paddedRow;	// One row of colour with KERNEL_SIZE / 2 clamped pixels either side.
+	std::vector<float> ring;		// The last KERNEL_SIZE horizontally blurred rows.
+	std::vector<float> accumRow;
+	std::vector<uint8_t> bgrRow;
+
+	// The rows this pipeline produces, [firstRow, endRow).
+	int firstRow;
+	int endRow;
+
+	// Both are rows of the whole image, not counted from the start of the range.
+	int nextInputRow;
+	int nextOutputRow;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////
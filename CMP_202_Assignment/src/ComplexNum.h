@@ -18,7 +18,8 @@ struct ComplexNum
 /////////////////////////////////////////////////////////////////////////////////////////////
 
 // Struct helper function.
-ComplexNum c_add(ComplexNum c1, ComplexNum c2) restrict(cpu, amp) // restrict keyword - able to execute this function on the GPU and CPU
+// These are inline as the fractal kernel templates pull this header in to more than one translation unit.
+inline ComplexNum c_add(ComplexNum c1, ComplexNum c2) restrict(cpu, amp) // restrict keyword - able to execute this function on the GPU and CPU
 {
 	ComplexNum tmp;
 	float a = c1.x;
@@ -34,7 +35,7 @@ ComplexNum c_add(ComplexNum c1, ComplexNum c2) restrict(cpu, amp) // restrict ke
 /////////////////////////////////////////////////////////////////////////////////////////////
 
 // Struct helper function.
-float c_abs(ComplexNum c) restrict(cpu, amp)
+inline float c_abs(ComplexNum c) restrict(cpu, amp)
 {
 	return concurrency::fast_math::sqrt(c.x * c.x + c.y * c.y);
 }
@@ -42,7 +43,7 @@ float c_abs(ComplexNum c) restrict(cpu, amp)
 /////////////////////////////////////////////////////////////////////////////////////////////
 
 // Struct helper function.
-ComplexNum c_mul(ComplexNum c1, ComplexNum c2) restrict(cpu, amp)
+inline ComplexNum c_mul(ComplexNum c1, ComplexNum c2) restrict(cpu, amp)
 {
 	ComplexNum tmp;
 	float a = c1.x;
@@ -55,4 +56,33 @@ ComplexNum c_mul(ComplexNum c1, ComplexNum c2) restrict(cpu, amp)
 	return tmp;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Struct helper function.
+// Raises z to a power known at compile time, this unrolls in to (Exponent - 1) calls to c_mul so there is no loop left in the kernel.
+template <int Exponent>
+inline ComplexNum c_pow(ComplexNum z) restrict(cpu, amp)
+{
+	return c_mul(c_pow<Exponent - 1>(z), z);
+}
+
+template <>
+inline ComplexNum c_pow<1>(ComplexNum z) restrict(cpu, amp)
+{
+	return z;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Struct helper function.
+// Folds z in to the first quadrant, used by the Burning Ship.
+inline ComplexNum c_fold(ComplexNum z) restrict(cpu, amp)
+{
+	ComplexNum tmp;
+	tmp.x = concurrency::fast_math::fabs(z.x);
+	tmp.y = concurrency::fast_math::fabs(z.y);
+
+	return tmp;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
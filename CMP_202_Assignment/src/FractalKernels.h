@@ -0,0 +1,395 @@
+#pragma once
+#include "ColourPalette.h"
+#include "ComplexNum.h"
+#include <amp.h>
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace concurrency;
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Everything the kernel needs to know about where in the complex plane it is rendering.
+// Passed by value in to the kernel so it gets captured by the lambda.
+struct FractalView
+{
+	float left;
+	float right;
+	float top;
+	float bottom;
+	int frameWidth;		// Size of the whole image, not just the rows being computed.
+	int frameHeight;
+	int yPosSt;			// The first row of the image that arrView[0] maps to.
+	ComplexNum seed;	// The constant c for Julia sets, ignored by the others.
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// One small image in a batch of thumbnails, see render_thumbnails_AMP.
+// Every member is 32 bits so an array of these can go straight in to an array_view.
+struct ThumbnailJob
+{
+	int firstPixel;		// Where this thumbnail starts in the batch's pixel buffer.
+	int width;
+	int height;
+	float left;
+	float right;
+	float top;
+	float bottom;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// FRACTAL FORMULAS
+
+/*
+ * Each formula says how to set up z and c for a pixel and how to take one step.
+ * They are only ever used as template parameters so the compiler inlines them straight
+ * in to the escape time loop, there is no switch on the type of fractal per iteration.
+ */
+
+// z = z^d + c, starting at z = 0 with c being the pixel.
+struct MandelbrotFormula
+{
+	static void init(ComplexNum pixel, ComplexNum seed, ComplexNum& z, ComplexNum& c) restrict(cpu, amp)
+	{
+		z.x = 0.0f;
+		z.y = 0.0f;
+		c = pixel;
+	}
+
+	template <int Exponent>
+	static ComplexNum step(ComplexNum z, ComplexNum c) restrict(cpu, amp)
+	{
+		return c_add(c_pow<Exponent>(z), c);
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// z = z^d + c, starting at z being the pixel with c fixed for the whole image.
+struct JuliaFormula
+{
+	static void init(ComplexNum pixel, ComplexNum seed, ComplexNum& z, ComplexNum& c) restrict(cpu, amp)
+	{
+		z = pixel;
+		c = seed;
+	}
+
+	template <int Exponent>
+	static ComplexNum step(ComplexNum z, ComplexNum c) restrict(cpu, amp)
+	{
+		return c_add(c_pow<Exponent>(z), c);
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// z = (|Re(z)| + i|Im(z)|)^d + c, the same as the Mandelbrot but z is folded before every step.
+struct BurningShipFormula
+{
+	static void init(ComplexNum pixel, ComplexNum seed, ComplexNum& z, ComplexNum& c) restrict(cpu, amp)
+	{
+		z.x = 0.0f;
+		z.y = 0.0f;
+		c = pixel;
+	}
+
+	template <int Exponent>
+	static ComplexNum step(ComplexNum z, ComplexNum c) restrict(cpu, amp)
+	{
+		return c_add(c_pow<Exponent>(c_fold(z)), c);
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// KERNEL TEMPLATES
+
+// Work out the point in the complex plane that corresponds to pixel (x, y) in the output image.
+inline ComplexNum pixel_to_complex(int x, int y, const FractalView& view) restrict(cpu, amp)
+{
+	ComplexNum pixel;
+	pixel.x = view.left + (x * (view.right - view.left) / view.frameWidth);
+	pixel.y = view.top + (y * (view.bottom - view.top) / view.frameHeight);
+
+	return pixel;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Iterate the formula until z moves more than 2 units away from (0, 0), or we've iterated too many times.
+// Returns the number of iterations it took to escape.
+template <typename Formula, int Exponent, int MaxIter>
+inline int escape_time(ComplexNum pixel, ComplexNum seed) restrict(cpu, amp)
+{
+	ComplexNum z;
+	ComplexNum c;
+	Formula::init(pixel, seed, z, c);
+
+	int iterations = 0;
+	float escapeRadius = 2.0f;
+
+	while (c_abs(z) < escapeRadius && iterations < MaxIter)
+	{
+		z = Formula::template step<Exponent>(z, c);
+
+		++iterations;
+	}
+
+	return iterations;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Turn an iteration count in to a packed 0x00RRGGBB colour.
+// If the iteration limit is bigger than the palette we wrap around it rather than read off the end.
+template <int MaxIter>
+inline uint32_t iterations_to_colour(int iterations, const array_view<Colour, 1>& paletteArrView) restrict(cpu, amp)
+{
+	if (iterations >= MaxIter - 1)
+	{
+		// z didn't escape from the circle.
+		// This point IS in the set.
+		return 0x000000; // black
+	}
+
+	int palIdx = iterations % paletteArrView.extent[0];
+
+	int red = paletteArrView[palIdx].colChannel_1;
+	int green = paletteArrView[palIdx].colChannel_2;
+	int blue = paletteArrView[palIdx].colChannel_3;
+
+	return (red << 16) | (green << 8) | (blue);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Render the fractal in to arrView, one thread per pixel.
+// A separate copy of this gets compiled for every Formula/Exponent/MaxIter combination used.
+template <typename Formula, int Exponent, int MaxIter>
+void render_fractal_AMP(array_view<uint32_t, 2> arrView, array_view<Colour, 1> paletteArrView, FractalView view)
+{
+	parallel_for_each(arrView.extent, [=](index<2> idx) restrict(amp)
+		{
+			// USE THREAD ID / INDEX TO MAP INTO THE COMPLEX PLANE
+			/*
+			 Here we are setting the value of x and y to the value contained at the
+			 concurrency::index object idx index position at positions [0] and [1].
+
+			 This is representative of 1 pixel.
+			 We create 1 thread per pixel and so this happen concurrently for ALL
+			 pixels in the image size, and so the fractal is calculated almost instantly.
+			*/
+			int y = idx[0] + view.yPosSt;	// Offset by the first row of the stripe we were given.
+			int x = idx[1];
+
+			ComplexNum pixel = pixel_to_complex(x, y, view);
+			int iterations = escape_time<Formula, Exponent, MaxIter>(pixel, view.seed);
+
+			arrView[idx] = iterations_to_colour<MaxIter>(iterations, paletteArrView);
+		});
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Render a whole batch of thumbnails in one launch, one thread per pixel across every thumbnail.
+// The thumbnails are packed one after another in pixelView, each thread finds the one it belongs
+// to with a binary search over the jobs (sorted by firstPixel) and then works as render_fractal_AMP.
+template <typename Formula, int Exponent, int MaxIter>
+void render_thumbnails_AMP(array_view<uint32_t, 1> pixelView, array_view<const ThumbnailJob, 1> jobView, array_view<Colour, 1> paletteArrView, ComplexNum seed)
+{
+	const int numJobs = jobView.extent[0];
+
+	parallel_for_each(pixelView.extent, [=](index<1> idx) restrict(amp)
+		{
+			int i = idx[0];
+
+			// Find the last job that starts at or before pixel i.
+			int low = 0;
+			int high = numJobs - 1;
+
+			while (low < high)
+			{
+				int mid = (low + high + 1) / 2;
+
+				if (jobView[mid].firstPixel <= i)
+				{
+					low = mid;
+				}
+				else
+				{
+					high = mid - 1;
+				}
+			}
+
+			ThumbnailJob job = jobView[low];
+
+			FractalView view;
+			view.left = job.left;
+			view.right = job.right;
+			view.top = job.top;
+			view.bottom = job.bottom;
+			view.frameWidth = job.width;
+			view.frameHeight = job.height;
+			view.yPosSt = 0;
+			view.seed = seed;
+
+			int local = i - job.firstPixel;
+			ComplexNum pixel = pixel_to_complex(local % job.width, local / job.width, view);
+			int iterations = escape_time<Formula, Exponent, MaxIter>(pixel, view.seed);
+
+			pixelView[idx] = iterations_to_colour<MaxIter>(iterations, paletteArrView);
+		});
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// AMP can only work with 32 bit elements, so to store the iteration counts compactly several are packed in to each word.
+// Counts are clamped to MaxIter - 1 as anything at or past that is coloured black anyway,
+// this way a limit of 256 still fits in 8 bits.
+template <int MaxIter>
+struct CountPacking
+{
+	static_assert(MaxIter <= 65536, "Iteration counts have to fit in 16 bits");
+
+	static const int bitsPerCount = (MaxIter <= 256) ? 8 : 16;
+	static const int countsPerWord = 32 / bitsPerCount;
+	static const uint32_t countMask = (1u << bitsPerCount) - 1;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Work out the iteration counts for countsPerWord neighbouring pixels along row y and pack them in to one word.
+// Shared by the AMP and CPU count kernels so they produce exactly the same buffer.
+template <typename Formula, int Exponent, int MaxIter>
+inline uint32_t count_word(int wordX, int y, const FractalView& view) restrict(cpu, amp)
+{
+	uint32_t word = 0;
+
+	for (int i = 0; i < CountPacking<MaxIter>::countsPerWord; ++i)
+	{
+		int x = wordX * CountPacking<MaxIter>::countsPerWord + i;
+
+		// The last word in a row may hang off the edge of the image if the width doesn't divide evenly.
+		if (x < view.frameWidth)
+		{
+			ComplexNum pixel = pixel_to_complex(x, y, view);
+			int iterations = escape_time<Formula, Exponent, MaxIter>(pixel, view.seed);
+			int count = (iterations < MaxIter - 1) ? iterations : MaxIter - 1;
+
+			word |= (uint32_t)count << (i * CountPacking<MaxIter>::bitsPerCount);
+		}
+	}
+
+	return word;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Render just the iteration counts in to countView, no colouring is done here.
+// Each thread works out countsPerWord neighbouring pixels along the row and packs them in to one word,
+// so countView is (frameWidth / countsPerWord) words wide, rounded up.
+template <typename Formula, int Exponent, int MaxIter>
+void render_counts_AMP(array_view<uint32_t, 2> countView, FractalView view)
+{
+	parallel_for_each(countView.extent, [=](index<2> idx) restrict(amp)
+		{
+			int y = idx[0] + view.yPosSt;
+
+			countView[idx] = count_word<Formula, Exponent, MaxIter>(idx[1], y, view);
+		});
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// CPU version of render_counts_AMP for numRows rows starting at view.yPosSt, written to pCounts.
+// Used by the CPU thread pool backends, each thread calls this on its own stripe of the image.
+template <typename Formula, int Exponent, int MaxIter>
+void render_counts_CPU(uint32_t* pCounts, int wordsPerRow, int numRows, FractalView view)
+{
+	for (int row = 0; row < numRows; ++row)
+	{
+		uint32_t* pRow = pCounts + ((size_t)row * wordsPerRow);
+		int y = row + view.yPosSt;
+
+		for (int w = 0; w < wordsPerRow; ++w)
+		{
+			pRow[w] = count_word<Formula, Exponent, MaxIter>(w, y, view);
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// The tiles used when building the iteration histogram, each tile keeps its own histogram in tile_static memory.
+const int HIST_TILE_SIZE = 16;
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// As render_counts_AMP, but each tile also counts how many pixels took each number of iterations.
+// Doing it per thread would need MaxIter bins per thread, so it's done per tile in tile_static memory with atomics,
+// then each tile adds its bins straight in to histView. histView has to be zeroed before the launch.
+template <typename Formula, int Exponent, int MaxIter>
+void render_counts_histogram_AMP(array_view<uint32_t, 2> countView, array_view<int, 1> histView, FractalView view)
+{
+	static_assert(MaxIter <= 4096, "The tile histogram has to fit in tile_static memory");
+
+	const int bitsPerCount = CountPacking<MaxIter>::bitsPerCount;
+	const int countsPerWord = CountPacking<MaxIter>::countsPerWord;
+	const int wordsHigh = countView.extent[0];
+	const int wordsWide = countView.extent[1];
+
+	// Pad the extent so the image doesn't have to be a multiple of the tile size, the extra threads just help with the histogram.
+	parallel_for_each(countView.extent.tile<HIST_TILE_SIZE, HIST_TILE_SIZE>().pad(), [=](tiled_index<HIST_TILE_SIZE, HIST_TILE_SIZE> t_idx) restrict(amp)
+		{
+			tile_static int histogram[MaxIter];
+
+			int localId = t_idx.local[0] * HIST_TILE_SIZE + t_idx.local[1];
+
+			for (int bin = localId; bin < MaxIter; bin += HIST_TILE_SIZE * HIST_TILE_SIZE)
+			{
+				histogram[bin] = 0;
+			}
+
+			t_idx.barrier.wait();
+
+			index<2> idx = t_idx.global;
+
+			if (idx[0] < wordsHigh && idx[1] < wordsWide)
+			{
+				int y = idx[0] + view.yPosSt;
+				uint32_t word = 0;
+
+				for (int i = 0; i < countsPerWord; ++i)
+				{
+					int x = idx[1] * countsPerWord + i;
+
+					if (x < view.frameWidth)
+					{
+						ComplexNum pixel = pixel_to_complex(x, y, view);
+						int iterations = escape_time<Formula, Exponent, MaxIter>(pixel, view.seed);
+						int count = (iterations < MaxIter - 1) ? iterations : MaxIter - 1;
+
+						word |= (uint32_t)count << (i * bitsPerCount);
+						atomic_fetch_inc(&histogram[count]);
+					}
+				}
+
+				countView[idx] = word;
+			}
+
+			t_idx.barrier.wait();
+
+			// Most tiles only hit a few bins, so skip the empty ones rather than hammer global memory with zeros.
+			for (int bin = localId; bin < MaxIter; bin += HIST_TILE_SIZE * HIST_TILE_SIZE)
+			{
+				if (histogram[bin] != 0)
+				{
+					atomic_fetch_add(&histView[bin], histogram[bin]);
+				}
+			}
+		});
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "FractalRegistry.h"
+#include "Mandlebrot.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// GLOBALS
+// Each line below instantiates its own copy of the kernels, so the formula, exponent and
+// iteration limit are all baked in to the code that runs on the accelerator.
+const FractalVariant fractalTable[] =
+{
+	// name, left, right, top, bottom, seed
+	make_fractal<MandelbrotFormula, 2, MAX_ITERATIONS>("mandelbrot", -2.0f, 1.0f, 1.125f, -1.125f, { 0.0f, 0.0f }),
+	make_fractal<MandelbrotFormula, 3, MAX_ITERATIONS>("multibrot3", -1.5f, 1.5f, 1.5f, -1.5f, { 0.0f, 0.0f }),
+	make_fractal<MandelbrotFormula, 4, MAX_ITERATIONS>("multibrot4", -1.5f, 1.5f, 1.5f, -1.5f, { 0.0f, 0.0f }),
+	make_fractal<MandelbrotFormula, 5, MAX_ITERATIONS>("multibrot5", -1.5f, 1.5f, 1.5f, -1.5f, { 0.0f, 0.0f }),
+	make_fractal<JuliaFormula, 2, MAX_ITERATIONS>("julia", -1.6f, 1.6f, 1.2f, -1.2f, { -0.8f, 0.156f }),
+	make_fractal<JuliaFormula, 3, MAX_ITERATIONS>("julia3", -1.5f, 1.5f, 1.5f, -1.5f, { 0.4f, 0.0f }),
+	make_fractal<BurningShipFormula, 2, MAX_ITERATIONS>("burningship", -2.2f, 1.3f, -1.8f, 0.8f, { 0.0f, 0.0f }),
+
+	// The zoomed in region from runMultipleTimings, needs more iterations to resolve the detail.
+	make_fractal<MandelbrotFormula, 2, MAX_ITERATIONS * 4>("mandelbrot_deep", -0.750785957889f, -0.748417618240f, -0.038876043075f, -0.037892170846f, { 0.0f, 0.0f }),
+};
+
+const int numFractals = sizeof(fractalTable) / sizeof(fractalTable[0]);
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// FUNCTIONS
+
+// Returns nullptr if there is no fractal registered under that name.
+const FractalVariant* FractalRegistry::find(const std::string& name)
+{
+	for (int i = 0; i < numFractals; ++i)
+	{
+		if (name == fractalTable[i].name)
+		{
+			return &fractalTable[i];
+		}
+	}
+
+	return nullptr;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// As find, but if there's no fractal by that name it says so and lists the ones there are.
+const FractalVariant* FractalRegistry::findOrList(const std::string& name)
+{
+	const FractalVariant* variant = find(name);
+
+	if (!variant)
+	{
+		std::cout << "No fractal called " << name << '\n';
+		listFractals();
+	}
+
+	return variant;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+void FractalRegistry::listFractals()
+{
+	std::cout << "Available fractals:" << '\n';
+
+	for (int i = 0; i < numFractals; ++i)
+	{
+		std::cout << "	" << fractalTable[i].name << " (" << fractalTable[i].maxIterations << " iterations)" << '\n';
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,73 @@
+#pragma once
+#include "FractalKernels.h"
+#include <string>
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Every specialised kernel has the same signature so they can all sit in the one table.
+typedef void (*FractalKernelFn)(array_view<uint32_t, 2> arrView, array_view<Colour, 1> paletteArrView, FractalView view);
+typedef void (*FractalCountKernelFn)(array_view<uint32_t, 2> countView, FractalView view);
+typedef void (*FractalHistogramKernelFn)(array_view<uint32_t, 2> countView, array_view<int, 1> histView, FractalView view);
+typedef void (*FractalCpuCountKernelFn)(uint32_t* pCounts, int wordsPerRow, int numRows, FractalView view);
+typedef void (*FractalThumbnailKernelFn)(array_view<uint32_t, 1> pixelView, array_view<const ThumbnailJob, 1> jobView, array_view<Colour, 1> paletteArrView, ComplexNum seed);
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// One entry in the table, the kernel plus a sensible default region to plot it in.
+struct FractalVariant
+{
+	const char* name;
+	FractalKernelFn kernel;
+	FractalCountKernelFn countKernel;
+	FractalHistogramKernelFn histogramKernel;
+	FractalCpuCountKernelFn cpuCountKernel;
+	FractalThumbnailKernelFn thumbnailKernel;
+	int maxIterations;
+	int countsPerWord;
+	float left;
+	float right;
+	float top;
+	float bottom;
+	ComplexNum seed;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Fills in a table entry so every kernel for a variant is instantiated with the same template arguments.
+template <typename Formula, int Exponent, int MaxIter>
+FractalVariant make_fractal(const char* name, float left, float right, float top, float bottom, ComplexNum seed)
+{
+	FractalVariant variant;
+	variant.name = name;
+	variant.kernel = render_fractal_AMP<Formula, Exponent, MaxIter>;
+	variant.countKernel = render_counts_AMP<Formula, Exponent, MaxIter>;
+	variant.histogramKernel = render_counts_histogram_AMP<Formula, Exponent, MaxIter>;
+	variant.cpuCountKernel = render_counts_CPU<Formula, Exponent, MaxIter>;
+	variant.thumbnailKernel = render_thumbnails_AMP<Formula, Exponent, MaxIter>;
+	variant.maxIterations = MaxIter;
+	variant.countsPerWord = CountPacking<MaxIter>::countsPerWord;
+	variant.left = left;
+	variant.right = right;
+	variant.top = top;
+	variant.bottom = bottom;
+	variant.seed = seed;
+
+	return variant;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Looks up the compile time specialised kernels by name.
+ * To add a new variant, add a line to the table in FractalRegistry.cpp.
+ * The table is fixed at compile time, so there is nothing to construct, it's all static.
+ */
+class FractalRegistry
+{
+public:
+	static const FractalVariant* find(const std::string& name);
+	static const FractalVariant* findOrList(const std::string& name);
+	static void listFractals();
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////
@@ -1,10 +1,23 @@
+#include "AutoTuner.h"
 #include "Filter.h"
 #include "Mandlebrot.h"
 #include "MyAMP.h"
+#include "NumaThreadPool.h"
+#include "RenderFarm.h"
+#include "StripeRenderer.h"
+#include "ThumbnailBatch.h"
 
 /////////////////////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <vector>
 
 ////////////////////// IMPORTANT INFO RELATED TO THE WARM UP CALL BELOW /////////////////////
 
@@ -30,6 +43,18 @@ void runAMPWarmUp(Mandlebrot* mandle)
 
 /////////////////////////////////////////////////////////////////////////////////////////////
 
+// Render with the settings saved by the autotuner and report how long it took.
+void renderTuned(AutoTuner* tuner, const TunedConfig& config, const std::string& name)
+{
+	long long time_taken = tuner->run(config, name);
+
+	std::cout << "Computing " << name << " with backend=" << config.backend << " blur=" << config.blur
+		<< " threads=" << config.numThreads << " tile_rows=" << config.tileRows
+		<< " and image blur took: " << time_taken << " ms." << '\n';
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
 void createMandlebrot(Mandlebrot* mandle)
 {
 	mandle->setUpCSV();
@@ -46,6 +71,264 @@ void setUpAMP(MyAMP* theAMP)
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 
+// Coordinator side of the render farm, spawns the workers on this machine and then hands them stripes.
+// Only listens on localhost unless bindAddress is given, e.g. 0.0.0.0 to take workers from other machines.
+void runRenderFarm(Mandlebrot* mandle, int numWorkers, int numStripes, const char* bindAddress)
+{
+	RenderFarm farm(mandle);
+
+	farm.spawnLocalWorkers(numWorkers, FARM_PORT);
+	farm.runCoordinator(-2.0, 1.0, 1.125, -1.125, numStripes, FARM_PORT, true, bindAddress);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+// Render one of the other fractal families using the region it was registered with.
+void createFractal(Mandlebrot* mandle, const std::string& name)
+{
+	const FractalVariant* variant = FractalRegistry::findOrList(name);
+
+	if (!variant)
+	{
+		return;
+	}
+
+	mandle->compute_fractal_with_AMP(name, variant->left, variant->right, variant->top, variant->bottom, 0, HEIGHT, true);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+// Same as createFractal but through the compact iteration count buffer and the single colouring pass.
+void createCompactFractal(Mandlebrot* mandle, const std::string& name, bool equalise)
+{
+	const FractalVariant* variant = FractalRegistry::findOrList(name);
+
+	if (!variant)
+	{
+		return;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	mandle->compute_fractal_compact(name, variant->left, variant->right, variant->top, variant->bottom, true, equalise);
+
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	auto time_taken = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+	std::cout << "Computing " << name << " with compact counts and image blur took: " << time_taken << " ms." << '\n';
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+// Render an image of any size a stripe at a time, straight to disk.
+void createStreamedFractal(const std::string& name, int width, int height, int stripeRows)
+{
+	const FractalVariant* variant = FractalRegistry::findOrList(name);
+
+	if (!variant)
+	{
+		return;
+	}
+
+	StripeRenderer renderer(width, height, stripeRows);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	if (renderer.render(name, variant->left, variant->right, variant->top, variant->bottom, true, "streamed_image.tga"))
+	{
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		auto time_taken = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+		std::cout << "Streaming " << name << " to streamed_image.tga took: " << time_taken << " ms." << '\n';
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+// Render on the CPU instead of the accelerator, with threads and memory placed per NUMA node.
+void createNumaFractal(Mandlebrot* mandle, const std::string& name, int numThreads, int stripeRows)
+{
+	const FractalVariant* variant = FractalRegistry::findOrList(name);
+
+	if (!variant)
+	{
+		return;
+	}
+
+	NumaThreadPool pool(numThreads);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	mandle->compute_fractal_numa(&pool, name, variant->left, variant->right, variant->top, variant->bottom, true, stripeRows);
+
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	auto time_taken = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+	std::cout << "Computing " << name << " on " << pool.getNumThreads() << " CPU threads with image blur took: " << time_taken << " ms." << '\n';
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+// Render the same image unfused (counts, then colour and blur) and fused (banded, in cache), and check they match.
+void createFusedFractal(Mandlebrot* mandle, const std::string& name, int numThreads, int stripeRows, int countRows)
+{
+	const FractalVariant* variant = FractalRegistry::findOrList(name);
+
+	if (!variant)
+	{
+		return;
+	}
+
+	NumaThreadPool pool(numThreads);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	mandle->compute_fractal_numa(&pool, name, variant->left, variant->right, variant->top, variant->bottom, true, stripeRows);
+
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	auto unfused_time = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+	start = std::chrono::steady_clock::now();
+
+	mandle->compute_fractal_fused(&pool, name, variant->left, variant->right, variant->top, variant->bottom, true, "fused_image.tga", countRows);
+
+	end = std::chrono::steady_clock::now();
+	auto fused_time = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+	std::cout << "Computing " << name << " then blurring took: " << unfused_time << " ms." << '\n';
+	std::cout << "Computing " << name << " fused with the blur took: " << fused_time << " ms." << '\n';
+
+	std::ifstream unfusedFile("blurred_image.tga", std::ifstream::binary);
+	std::ifstream fusedFile("fused_image.tga", std::ifstream::binary);
+
+	std::vector<char> unfused((std::istreambuf_iterator<char>(unfusedFile)), std::istreambuf_iterator<char>());
+	std::vector<char> fused((std::istreambuf_iterator<char>(fusedFile)), std::istreambuf_iterator<char>());
+
+	if (!unfused.empty() && unfused == fused)
+	{
+		std::cout << "fused_image.tga matches blurred_image.tga exactly." << '\n';
+	}
+	else
+	{
+		std::cout << "fused_image.tga does NOT match blurred_image.tga!" << '\n';
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+// Render count thumbnails of size x size, each one a different zoomed in window on the fractal.
+// Times them in one batch and then one launch at a time, and reports both as thumbnails per second.
+void createThumbnails(const std::string& name, int count, int size)
+{
+	ThumbnailBatch batch(name);
+	const FractalVariant* variant = FractalRegistry::find(name);
+
+	if (!variant || count < 1 || size < 1)
+	{
+		return;
+	}
+
+	// Walk the windows across the default region in a grid, each one a quarter of its width and height.
+	int gridSize = (int)ceil(sqrt((double)count));
+	float width = variant->right - variant->left;
+	float height = variant->bottom - variant->top;
+
+	for (int i = 0; i < count; ++i)
+	{
+		float left = variant->left + (width * (i % gridSize) / gridSize);
+		float top = variant->top + (height * (i / gridSize) / gridSize);
+
+		batch.addThumbnail(left, left + (width / 4.0f), top, top + (height / 4.0f), size, size);
+	}
+
+	// One untimed pass of each first, so neither timing includes the first launch of its kernel.
+	// runAMPWarmUp only covers the mandelbrot's full frame kernel, not these.
+	batch.renderOneAtATime();
+	batch.render();
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	bool rendered = batch.renderOneAtATime();
+
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	auto single_time = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+	// Keep a copy to check the batch gives the same pixels.
+	std::vector<uint32_t> singlePixels;
+
+	for (int i = 0; i < batch.getNumThumbnails(); ++i)
+	{
+		singlePixels.insert(singlePixels.end(), batch.getPixels(i), batch.getPixels(i) + (size * size));
+	}
+
+	start = std::chrono::steady_clock::now();
+
+	rendered = batch.render() && rendered;
+
+	end = std::chrono::steady_clock::now();
+	auto batch_time = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+	if (!rendered)
+	{
+		return;
+	}
+
+	std::cout << "Rendering " << count << " " << size << "x" << size << " thumbnails of " << name << '\n';
+	std::cout << "One at a time took: " << single_time / 1000 << " ms, "
+		<< (count * 1000000.0) / std::max<long long>(single_time, 1) << " thumbnails per second." << '\n';
+	std::cout << "In one batch took: " << batch_time / 1000 << " ms, "
+		<< (count * 1000000.0) / std::max<long long>(batch_time, 1) << " thumbnails per second." << '\n';
+
+	if (std::equal(singlePixels.begin(), singlePixels.end(), batch.getPixels(0)))
+	{
+		std::cout << "The batch matches the thumbnails rendered one at a time." << '\n';
+	}
+	else
+	{
+		std::cout << "The batch does NOT match the thumbnails rendered one at a time!" << '\n';
+	}
+
+	batch.write_tga(0, "thumbnail_image.tga");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+// Render with the settings saved by the autotuner, running the sweep first if there aren't any yet (or if asked to).
+// tuned is what main loaded from the config file, or nullptr if there wasn't a usable one.
+void createTunedFractal(Mandlebrot* mandle, MyAMP* amp, AutoTuner* tuner, const TunedConfig* tuned, const std::string& name, bool retune)
+{
+	if (!FractalRegistry::findOrList(name))
+	{
+		return;
+	}
+
+	TunedConfig config;
+
+	if (retune || !tuned)
+	{
+		// The sweep only tries the accelerator if there's a real one, so only then is it worth warming up.
+		if (amp->hasHardwareAccelerator())
+		{
+			runAMPWarmUp(mandle);
+		}
+
+		std::cout << "Tuning for this machine, this only has to be done once..." << '\n';
+		config = tuner->tune(name);
+	}
+	else
+	{
+		config = *tuned;
+
+		if (config.backend == "amp")
+		{
+			runAMPWarmUp(mandle);
+		}
+
+		std::cout << "Using the tuned settings from " << TUNED_CONFIG_FILE << '\n';
+	}
+
+	renderTuned(tuner, config, name);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
 void imagePrefs(int& size)
 {
 	std::cout << "Please enter size of image to generate, (256 - 1024):> ";
@@ -69,6 +352,28 @@ void imagePrefs(int& size)
 
  // ######################### NOTE #########################
 
+/*
+ * Command line options:
+ *	--farm <workers> <stripes> [bind address]
+ *								Render as a coordinator, launching <workers> local worker processes.
+ *								Listens on localhost only unless a bind address is given.
+ *	--worker <host> <port>		Run as a render farm worker, launched by the coordinator.
+ *	--fractal <name>			Render one of the fractals from FractalRegistry.cpp, e.g. julia or burningship.
+ *	--compact <name>			As --fractal, but stores 8/16 bit iteration counts and colours/blurs in one pass.
+ *	--equalise <name>			As --compact, but with the colours histogram equalised.
+ *	--stream <name> <width> <height> [stripe rows]
+ *								Render an image of any size (up to 65535x65535) in stripes with bounded memory.
+ *	--numa <name> [threads]		Render on the CPU thread pool, pinned per NUMA node.
+ *	--fused <name> [threads]	As --numa, then again with the blur fused in to the render, and check the two match.
+ *								Both use the thread count and tile rows from tuned_config.txt when it was tuned for <name>.
+ *	--thumbnails <name> <count> [size]
+ *								Render lots of small images (128x128 by default) in one batch, timed in thumbnails per second.
+ *	--tuned <name>				Render with the fastest settings for this machine, tuning them first if needed.
+ *	--tune <name>				As --tuned, but always runs the tuning sweep again.
+ *
+ * With no options the mandelbrot is timed 25 times on the accelerator and the times go in the CSV,
+ * the tuned settings are never used so the benchmark stays comparable between runs.
+ */
 int main(int argc, char* argv[])
 {
 	MyAMP ampObj;
@@ -79,7 +384,112 @@ int main(int argc, char* argv[])
 	//Mandlebrot mandlebrot(size);
 	Mandlebrot mandlebrot;
 
+	if (argc == 4 && strcmp(argv[1], "--worker") == 0)
+	{
+		// Workers stay quiet and skip the accelerator report, the coordinator does the talking.
+		RenderFarm farm(&mandlebrot);
+		farm.runWorker(argv[2], (unsigned short)atoi(argv[3]));
+
+		return 0;
+	}
+
 	setUpAMP(&ampObj);
+
+	if ((argc == 4 || argc == 5) && strcmp(argv[1], "--farm") == 0)
+	{
+		std::cout << "Please wait while the image is generated by the render farm..." << '\n';
+		runRenderFarm(&mandlebrot, atoi(argv[2]), atoi(argv[3]), (argc == 5) ? argv[4] : nullptr);
+
+		return 0;
+	}
+
+	if (argc == 3 && strcmp(argv[1], "--fractal") == 0)
+	{
+		runAMPWarmUp(&mandlebrot);
+
+		std::cout << "Please wait while the image is generated..." << '\n';
+		createFractal(&mandlebrot, argv[2]);
+
+		return 0;
+	}
+
+	if (argc == 3 && (strcmp(argv[1], "--compact") == 0 || strcmp(argv[1], "--equalise") == 0))
+	{
+		runAMPWarmUp(&mandlebrot);
+
+		std::cout << "Please wait while the image is generated..." << '\n';
+		createCompactFractal(&mandlebrot, argv[2], strcmp(argv[1], "--equalise") == 0);
+
+		return 0;
+	}
+
+	if ((argc == 5 || argc == 6) && strcmp(argv[1], "--stream") == 0)
+	{
+		int stripeRows = (argc == 6) ? atoi(argv[5]) : DEFAULT_STRIPE_ROWS;
+
+		runAMPWarmUp(&mandlebrot);
+		createStreamedFractal(argv[2], atoi(argv[3]), atoi(argv[4]), stripeRows);
+
+		return 0;
+	}
+
+	// Loaded once here so every mode that can use the tuned settings sees the same ones.
+	bool namesFractal = (argc >= 3) && (strcmp(argv[1], "--numa") == 0 || strcmp(argv[1], "--fused") == 0
+		|| strcmp(argv[1], "--tuned") == 0 || strcmp(argv[1], "--tune") == 0);
+
+	AutoTuner tuner(&mandlebrot, &ampObj);
+	TunedConfig tunedConfig;
+	const TunedConfig* tuned = nullptr;
+
+	if (namesFractal && tuner.loadConfig(argv[2], tunedConfig))
+	{
+		tuned = &tunedConfig;
+	}
+
+	// Only the cpu backend has threads and tile rows, the constants from Mandlebrot.h are used otherwise.
+	bool tunedCpu = tuned && tuned->backend == "cpu";
+	int tunedThreads = tunedCpu ? tuned->numThreads : 0;
+	int tunedStripeRows = (tunedCpu && tuned->blur == "separate") ? tuned->tileRows : NUMA_STRIPE_ROWS;
+	int tunedCountRows = (tunedCpu && tuned->blur == "fused") ? tuned->tileRows : FUSED_COUNT_ROWS;
+
+	if ((argc == 3 || argc == 4) && strcmp(argv[1], "--numa") == 0)
+	{
+		int numThreads = (argc == 4) ? atoi(argv[3]) : tunedThreads;
+
+		std::cout << "Please wait while the image is generated..." << '\n';
+		createNumaFractal(&mandlebrot, argv[2], numThreads, tunedStripeRows);
+
+		return 0;
+	}
+
+	if ((argc == 3 || argc == 4) && strcmp(argv[1], "--fused") == 0)
+	{
+		int numThreads = (argc == 4) ? atoi(argv[3]) : tunedThreads;
+
+		std::cout << "Please wait while the image is generated..." << '\n';
+		createFusedFractal(&mandlebrot, argv[2], numThreads, tunedStripeRows, tunedCountRows);
+
+		return 0;
+	}
+
+	if ((argc == 4 || argc == 5) && strcmp(argv[1], "--thumbnails") == 0)
+	{
+		int size = (argc == 5) ? atoi(argv[4]) : 128;
+
+		runAMPWarmUp(&mandlebrot);
+		createThumbnails(argv[2], atoi(argv[3]), size);
+
+		return 0;
+	}
+
+	if (argc == 3 && (strcmp(argv[1], "--tuned") == 0 || strcmp(argv[1], "--tune") == 0))
+	{
+		std::cout << "Please wait while the image is generated..." << '\n';
+		createTunedFractal(&mandlebrot, &ampObj, &tuner, tuned, argv[2], strcmp(argv[1], "--tune") == 0);
+
+		return 0;
+	}
+
 	runAMPWarmUp(&mandlebrot);
 
 	std::cout << "Please wait while the image is generated..." << '\n';
@@ -1,9 +1,12 @@
 #include "Mandlebrot.h"
-#include "ComplexNum.h"
+#include "ColourPipeline.h"
 #include "Filter.h"
+#include "FractalRegistry.h"
+#include "NumaThreadPool.h"
 
 /////////////////////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
 #include <amp.h>
 #include <chrono>
 #include <iostream>
@@ -37,6 +40,10 @@ std::ofstream timings("size_1024x_timings.csv");
 uint32_t image[HEIGHT][WIDTH];
 uint32_t blurImage[HEIGHT][WIDTH];
 
+// Packed iteration counts for the compact path, sized for the worst case of 2 counts per word.
+// Rows are rounded up to a whole word, so an odd WIDTH still fits. With 8 bit counts only about the first quarter of it gets used.
+uint32_t countImage[HEIGHT * ((WIDTH + 1) / 2)];
+
 // Define the alias "the_clock" for the clock type we're going to use.
 typedef std::chrono::steady_clock the_clock;
 
@@ -161,79 +168,61 @@ void Mandlebrot::write_tga(const char* filename, bool blur)
 // This will render the mandlebrot using C++ AMP without tiling explicitly.
 void Mandlebrot::compute_mandelbrot_with_AMP(float left, float right, float top, float bottom, int yPosSt, int yPosEnd, bool blur, bool writeImage)
 {
+	compute_fractal_with_AMP("mandelbrot", left, right, top, bottom, yPosSt, yPosEnd, blur, writeImage);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Render any of the fractals registered in FractalRegistry.cpp into the image array.
+// The name is only looked up once per call, the kernel that runs has the formula compiled in to it.
+void Mandlebrot::compute_fractal_with_AMP(const std::string& name, float left, float right, float top, float bottom, int yPosSt, int yPosEnd, bool blur, bool writeImage)
+{
+	// The rows are used to point the array view in to image, so anything outside it has to be stopped here.
+	if (yPosSt < 0 || yPosEnd > HEIGHT || yPosSt >= yPosEnd)
+	{
+		cout << "Rows " << yPosSt << " to " << yPosEnd << " are not a valid range of the image" << endl;
+		return;
+	}
+
+	const FractalVariant* variant = FractalRegistry::findOrList(name);
+
+	if (!variant)
+	{
+		return;
+	}
+
 	//std::vector<unsigned int> colPalette = palette.createPalette();
 	std::vector<Colour> colPalette = palette.createPalette();
 
 	// Create a pointer that points to the same location as the first index of image data 2d array.
 	uint32_t* pImage = &(image[0][0]);
 
-	// Create an array view copying in the data of pImage, we need this as the GPU can only work with array_view and NOT arrays.
+	// Only the rows in the range [yPosSt, yPosEnd) are computed, this lets the render farm hand out horizontal stripes.
+	// The array view is wrapped around just those rows so that synchronize() doesn't copy stale data over the rest of the image.
+	int numRows = yPosEnd - yPosSt;
+	uint32_t* pStripe = &(image[yPosSt][0]);
+
+	// Create an array view copying in the data of pStripe, we need this as the GPU can only work with array_view and NOT arrays.
 	// We could have created an extent object and passed that as the second param, in this case we have hard coded the value 2.
-	array_view<uint32_t, 2> arrView(HEIGHT, WIDTH, pImage);
+	array_view<uint32_t, 2> arrView(numRows, WIDTH, pStripe);
 	//array_view<unsigned int, 1> paletteArrView(colPalette.size(), colPalette);
 	array_view<Colour, 1> paletteArrView(colPalette.size(), colPalette);
 	arrView.discard_data();
 
+	FractalView view;
+	view.left = left;
+	view.right = right;
+	view.top = top;
+	view.bottom = bottom;
+	view.frameWidth = WIDTH;
+	view.frameHeight = HEIGHT;
+	view.yPosSt = yPosSt;
+	view.seed = variant->seed;
+
 	try
 	{
-		parallel_for_each(arrView.extent, [=](index<2> idx) restrict(amp)
-			{
-				/* compute Mandelbrot here i.e. Mandelbrot kernel/shader */
-
-				// USE THREAD ID / INDEX TO MAP INTO THE COMPLEX PLANE
-				/*
-				 Here we are setting the value of x and y to the value contained at the
-				 concurrency::index object idx index position at positions [0] and [1].
-
-				 This is representative of 1 pixel.
-				 We create 1 thread per pixel and so this happen concurrently for ALL
-				 pixels in the image size, and so the mandlebrot is calculated almost instantly.
-				*/
-				int y = idx[0];		// The x component of the pixel.
-				int x = idx[1];		// The y component of the pixel.
-
-				// Work out the point in the complex plane that
-				// corresponds to this pixel in the output image.
-				ComplexNum c;
-				c.x = left + (x * (right - left) / WIDTH);
-				c.y = top + (y * (bottom - top) / HEIGHT);
-
-				// Start off z at (0, 0).
-				ComplexNum z;
-				z.x = 0.0f;
-				z.y = 0.0f;
-
-				// Iterate z = z^2 + c until z moves more than 2 units
-				// away from (0, 0), or we've iterated too many times.
-				int iterations = 0;
-				float escapeRadius = 2.0f;
-
-				while (c_abs(z) < escapeRadius && iterations < MAX_ITERATIONS)
-				{
-					z = c_mul(z, z);
-					z = c_add(z, c);
-
-					++iterations;
-				}
-
-				if (iterations == MAX_ITERATIONS - 1)
-				{
-					// z didn't escape from the circle.
-					// This point IS in the Mandelbrot set.
-					arrView[idx] = 0x000000; // black
-				}
-				else
-				{
-					int red = paletteArrView[iterations].colChannel_1;
-					int green = paletteArrView[iterations].colChannel_2;
-					int blue = paletteArrView[iterations].colChannel_3;
-
-					int finalCol = (red << 16) | (green << 8) | (blue);
-
-					arrView[idx] = finalCol;
-					//arrView[idx] = paletteArrView[iterations].colChannel_2;
-				}
-			});
+		/* compute fractal here i.e. the specialised kernel/shader, see FractalKernels.h */
+		variant->kernel(arrView, paletteArrView, view);
 
 		arrView.synchronize();
 	}
@@ -257,6 +246,374 @@ void Mandlebrot::compute_mandelbrot_with_AMP(float left, float right, float top,
 
 /////////////////////////////////////////////////////////////////////////////////////////////
 
+// Render only the iteration counts (8 or 16 bits each) and then do the colouring, blur and
+// BGR packing in one pass on the way out to the file. This never touches image or blurImage.
+// With equalise on the colours are histogram equalised, see ColourPalette::createEqualisedLUT.
+void Mandlebrot::compute_fractal_compact(const std::string& name, float left, float right, float top, float bottom, bool blur, bool equalise, bool writeImage)
+{
+	const FractalVariant* variant = FractalRegistry::findOrList(name);
+
+	if (!variant)
+	{
+		return;
+	}
+
+	int wordsPerRow = (WIDTH + variant->countsPerWord - 1) / variant->countsPerWord;
+
+	array_view<uint32_t, 2> countView(HEIGHT, wordsPerRow, countImage);
+	countView.discard_data();
+
+	FractalView view;
+	view.left = left;
+	view.right = right;
+	view.top = top;
+	view.bottom = bottom;
+	view.frameWidth = WIDTH;
+	view.frameHeight = HEIGHT;
+	view.yPosSt = 0;
+	view.seed = variant->seed;
+
+	std::vector<Colour> lut;
+
+	try
+	{
+		if (equalise)
+		{
+			the_clock::time_point start = the_clock::now();
+
+			// Every tile adds its bins in to this at the end, so it has to go over zeroed rather than be discarded.
+			std::vector<int> histogram(variant->maxIterations, 0);
+			array_view<int, 1> histView(variant->maxIterations, histogram);
+
+			variant->histogramKernel(countView, histView, view);
+
+			countView.synchronize();
+			histView.synchronize();
+
+			the_clock::time_point kernelEnd = the_clock::now();
+
+			lut = palette.createEqualisedLUT(histogram);
+
+			// The CDF is only MaxIter long, so this should be next to nothing compared to the render.
+			the_clock::time_point end = the_clock::now();
+			cout << "Counts with histogram took: " << duration_cast<milliseconds>(kernelEnd - start).count() << " ms, "
+				<< "equalising the palette took: " << duration_cast<milliseconds>(end - kernelEnd).count() << " ms." << endl;
+		}
+		else
+		{
+			variant->countKernel(countView, view);
+
+			countView.synchronize();
+
+			lut = palette.createIterationLUT(variant->maxIterations);
+		}
+	}
+	catch (const concurrency::runtime_exception& ex)
+	{
+		MessageBoxA(NULL, ex.what(), "Error with computing iteration counts", MB_ICONERROR);
+		return;
+	}
+
+	// The second pass, this is where the counts go through the (possibly equalised) LUT.
+	ColourPipeline pipeline(WIDTH, HEIGHT, lut, variant->countsPerWord, blur);
+
+	if (!writeImage)
+	{
+		// Still colour and blur every row so the work done is the same, just keep the result in memory.
+		std::vector<uint8_t> bgrImage((size_t)HEIGHT * WIDTH * 3);
+
+		for (int y = 0; y < HEIGHT; ++y)
+		{
+			pipeline.pushRow(&countImage[y * wordsPerRow], bgrImage.data());
+		}
+
+		pipeline.finish(bgrImage.data());
+		return;
+	}
+
+	const char* filename = blur ? "blurred_image.tga" : "original_image.tga";
+	ofstream outfile(filename, ofstream::binary);
+
+	ColourPipeline::writeHeader(outfile, WIDTH, HEIGHT);
+
+	for (int y = 0; y < HEIGHT; ++y)
+	{
+		pipeline.pushRow(&countImage[y * wordsPerRow], outfile);
+	}
+
+	pipeline.finish(outfile);
+
+	outfile.close();
+	if (!outfile)
+	{
+		// An error has occurred at some point since we opened the file.
+		cout << "Error writing to " << filename << endl;
+		exit(1);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// CPU version of compute_fractal_compact using the NUMA aware thread pool.
+// The count buffer is a NumaFrame rather than countImage, so each stripe lives in the memory of the node that renders it.
+// The colour and blur pass is split the same way, in bands of whole stripes run on the node that owns them, and
+// only the finished rows are written out from this thread.
+void Mandlebrot::compute_fractal_numa(NumaThreadPool* pool, const std::string& name, float left, float right, float top, float bottom, bool blur, int stripeRows, bool writeImage)
+{
+	const FractalVariant* variant = FractalRegistry::findOrList(name);
+
+	if (!variant)
+	{
+		return;
+	}
+
+	int wordsPerRow = (WIDTH + variant->countsPerWord - 1) / variant->countsPerWord;
+	int numStripes = (HEIGHT + stripeRows - 1) / stripeRows;
+	size_t bytesPerStripe = (size_t)stripeRows * wordsPerRow * sizeof(uint32_t);
+
+	NumaFrame frame(pool, numStripes, bytesPerStripe);
+
+	// The colour pass works in bands of whole stripes, at least one per thread so every thread has a share of the
+	// memory bound half too. Each band also reads the KERNEL_SIZE / 2 rows either side of it, which is the price of that.
+	int stripesPerBand = std::max(1, numStripes / pool->getNumThreads());
+	int bandRows = stripesPerBand * stripeRows;
+	int numBands = (HEIGHT + bandRows - 1) / bandRows;
+	size_t bytesPerBand = (size_t)bandRows * WIDTH * 3;
+
+	NumaFrame bgrFrame(pool, numBands, bytesPerBand);
+
+	FractalView view;
+	view.left = left;
+	view.right = right;
+	view.top = top;
+	view.bottom = bottom;
+	view.frameWidth = WIDTH;
+	view.frameHeight = HEIGHT;
+	view.seed = variant->seed;
+
+	// Only count the render, not the first touch done by the NumaFrames.
+	pool->resetCounters();
+
+	pool->forEachStripe(numStripes, bytesPerStripe, true, [&](int s, int)
+		{
+			FractalView stripeView = view;
+			stripeView.yPosSt = s * stripeRows;
+
+			int numRows = std::min(stripeRows, HEIGHT - stripeView.yPosSt);
+			variant->cpuCountKernel(frame.stripe(s), wordsPerRow, numRows, stripeView);
+		});
+
+	std::vector<Colour> lut = palette.createIterationLUT(variant->maxIterations);
+
+	pool->forEachStripe(numBands, bytesPerBand, true, [&](int b, int node)
+		{
+			int firstRow = b * bandRows;
+			int endRow = std::min(firstRow + bandRows, HEIGHT);
+			uint8_t* pBgrRows = (uint8_t*)bgrFrame.stripe(b);
+
+			ColourPipeline pipeline(WIDTH, HEIGHT, lut, variant->countsPerWord, blur);
+			pipeline.setRowRange(firstRow, endRow);
+
+			for (int y = pipeline.getFirstInputRow(); y < pipeline.getEndInputRow(); ++y)
+			{
+				int s = y / stripeRows;
+
+				// The halo rows, the edges of a band, or all of it if the band was stolen, can be in stripes first touched on another node.
+				if (pool->ownerNode(s, numStripes) != node)
+				{
+					pool->addRemoteBytes((long long)wordsPerRow * sizeof(uint32_t));
+				}
+
+				pipeline.pushRow(frame.stripe(s) + ((y % stripeRows) * wordsPerRow), pBgrRows);
+			}
+
+			pipeline.finish(pBgrRows);
+		});
+
+	pool->reportCounters();
+
+	// The rows are already finished in bgrFrame, all that's left is the file.
+	if (!writeImage)
+	{
+		return;
+	}
+
+	const char* filename = blur ? "blurred_image.tga" : "original_image.tga";
+	ofstream outfile(filename, ofstream::binary);
+
+	ColourPipeline::writeHeader(outfile, WIDTH, HEIGHT);
+
+	for (int b = 0; b < numBands; ++b)
+	{
+		int numRows = std::min(bandRows, HEIGHT - (b * bandRows));
+		outfile.write((const char*)bgrFrame.stripe(b), (size_t)numRows * WIDTH * 3);
+	}
+
+	outfile.close();
+	if (!outfile)
+	{
+		// An error has occurred at some point since we opened the file.
+		cout << "Error writing to " << filename << endl;
+		exit(1);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Fused version of compute_fractal_numa, nothing the size of the whole frame is ever written until the final pixels.
+ * The image is split in to one band per thread (times two, for balance). Each band computes countRows rows
+ * of counts at a time and pushes them straight in to its own ColourPipeline, so the counts and the ring of colour
+ * rows stay in cache and only finished rows go out to memory.
+ * The KERNEL_SIZE / 2 rows either side of each boundary between bands are needed by both bands, so they are
+ * computed once, first, and shared. Otherwise on machines with lots of threads (so lots of thin bands) working
+ * out the halo twice would be most of the work.
+ */
+void Mandlebrot::compute_fractal_fused(NumaThreadPool* pool, const std::string& name, float left, float right, float top, float bottom, bool blur, const char* filename, int countRows, bool writeImage)
+{
+	const FractalVariant* variant = FractalRegistry::findOrList(name);
+
+	if (!variant)
+	{
+		return;
+	}
+
+	int wordsPerRow = (WIDTH + variant->countsPerWord - 1) / variant->countsPerWord;
+	int numBands = std::min(pool->getNumThreads() * 2, HEIGHT);
+	int bandRows = (HEIGHT + numBands - 1) / numBands;
+	numBands = (HEIGHT + bandRows - 1) / bandRows;
+
+	size_t bytesPerBand = (size_t)bandRows * WIDTH * 3;
+
+	// The finished BGR rows, each band's rows are first touched by the node that renders them.
+	NumaFrame frame(pool, numBands, bytesPerBand);
+
+	// The count rows around each boundary, only needed when blurring. When the bands are thinner than the halo
+	// the boundaries overlap, so each one only claims the rows the boundary before it hasn't.
+	int halo = blur ? KERNEL_SIZE / 2 : 0;
+	int numBoundaries = blur ? numBands - 1 : 0;
+	size_t bytesPerBoundary = (size_t)(2 * halo) * wordsPerRow * sizeof(uint32_t);
+
+	std::vector<int> claimedFirst(numBoundaries);
+	std::vector<int> claimedEnd(numBoundaries);
+	std::vector<int> sharedBy(HEIGHT, -1);		// Which boundary computed each row, -1 if a band does it itself.
+
+	for (int i = 0; i < numBoundaries; ++i)
+	{
+		int boundary = (i + 1) * bandRows;
+
+		claimedFirst[i] = std::max(boundary - halo, (i > 0) ? claimedEnd[i - 1] : 0);
+		claimedEnd[i] = std::max(std::min(boundary + halo, HEIGHT), claimedFirst[i]);
+
+		for (int y = claimedFirst[i]; y < claimedEnd[i]; ++y)
+		{
+			sharedBy[y] = i;
+		}
+	}
+
+	NumaFrame haloFrame(pool, numBoundaries, bytesPerBoundary);
+
+	std::vector<Colour> lut = palette.createIterationLUT(variant->maxIterations);
+
+	FractalView view;
+	view.left = left;
+	view.right = right;
+	view.top = top;
+	view.bottom = bottom;
+	view.frameWidth = WIDTH;
+	view.frameHeight = HEIGHT;
+	view.seed = variant->seed;
+
+	pool->resetCounters();
+
+	// The shared halo rows first, a handful of rows per boundary so this is quick.
+	pool->forEachStripe(numBoundaries, bytesPerBoundary, true, [&](int i, int)
+		{
+			FractalView haloView = view;
+			haloView.yPosSt = claimedFirst[i];
+
+			variant->cpuCountKernel(haloFrame.stripe(i), wordsPerRow, claimedEnd[i] - claimedFirst[i], haloView);
+		});
+
+	pool->forEachStripe(numBands, bytesPerBand, true, [&](int b, int node)
+		{
+			int firstRow = b * bandRows;
+			int endRow = std::min(firstRow + bandRows, HEIGHT);
+			uint8_t* pBgrRows = (uint8_t*)frame.stripe(b);
+
+			ColourPipeline pipeline(WIDTH, HEIGHT, lut, variant->countsPerWord, blur);
+			pipeline.setRowRange(firstRow, endRow);
+
+			std::vector<uint32_t> counts((size_t)countRows * wordsPerRow);
+			FractalView bandView = view;
+
+			for (int y = pipeline.getFirstInputRow(); y < pipeline.getEndInputRow(); )
+			{
+				int i = sharedBy[y];
+
+				if (i >= 0)
+				{
+					// Computed by the boundary, possibly on another node.
+					if (pool->ownerNode(i, numBoundaries) != node)
+					{
+						pool->addRemoteBytes((long long)wordsPerRow * sizeof(uint32_t));
+					}
+
+					pipeline.pushRow(haloFrame.stripe(i) + ((size_t)(y - claimedFirst[i]) * wordsPerRow), pBgrRows);
+					++y;
+					continue;
+				}
+
+				// Up to countRows of this band's own rows, stopping at the next shared row.
+				int numRows = 0;
+
+				while (numRows < countRows && y + numRows < pipeline.getEndInputRow() && sharedBy[y + numRows] < 0)
+				{
+					++numRows;
+				}
+
+				bandView.yPosSt = y;
+				variant->cpuCountKernel(counts.data(), wordsPerRow, numRows, bandView);
+
+				for (int row = 0; row < numRows; ++row)
+				{
+					pipeline.pushRow(&counts[(size_t)row * wordsPerRow], pBgrRows);
+				}
+
+				y += numRows;
+			}
+
+			pipeline.finish(pBgrRows);
+		});
+
+	pool->reportCounters();
+
+	if (!writeImage)
+	{
+		return;
+	}
+
+	ofstream outfile(filename, ofstream::binary);
+
+	ColourPipeline::writeHeader(outfile, WIDTH, HEIGHT);
+
+	for (int b = 0; b < numBands; ++b)
+	{
+		int numRows = std::min(bandRows, HEIGHT - (b * bandRows));
+		outfile.write((const char*)frame.stripe(b), (size_t)numRows * WIDTH * 3);
+	}
+
+	outfile.close();
+	if (!outfile)
+	{
+		// An error has occurred at some point since we opened the file.
+		cout << "Error writing to " << filename << endl;
+		exit(1);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
 void Mandlebrot::applyBlur(uint32_t* inputImage, bool writeImage)
 {
 	// Pointer to a new empty container ready to store the blurred mandlebrot image.
@@ -398,6 +755,13 @@ void Mandlebrot::setUpCSV()
 /////////////////////////////////////////////////////////////////////////////////////////////
 
 // GETTERS / SETTERS
+uint32_t* Mandlebrot::getImage()
+{
+	return &(image[0][0]);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
 int Mandlebrot::getHeight()
 {
 	return HEIGHT;
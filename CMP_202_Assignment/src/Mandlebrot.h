@@ -1,5 +1,6 @@
 #pragma once
 #include "ColourPalette.h"
+#include "FractalRegistry.h"
 
 /////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -16,6 +17,14 @@ const int HEIGHT = 1024;
 // Good rule of thumb is to keep this and the palette size the same number.
 const int MAX_ITERATIONS = 256;
 
+// How many rows of the image go in each stripe when rendering on the CPU thread pool, unless the autotuner says otherwise.
+const int NUMA_STRIPE_ROWS = 16;
+
+// How many rows of counts the fused path works out at a time before colouring and blurring them, unless the autotuner says otherwise.
+const int FUSED_COUNT_ROWS = 8;
+
+class NumaThreadPool;
+
 //struct constDimension
 //{
 //	const int WIDTH;
@@ -34,11 +43,16 @@ public:
 	void initImageContainers(int SIZE);
 	void write_tga(const char* filename, bool blur);
 	void compute_mandelbrot_with_AMP(float left, float right, float top, float bottom, int yPosSt = 0, int yPosEnd = HEIGHT, bool blur = false, bool writeImage = true);
+	void compute_fractal_with_AMP(const std::string& name, float left, float right, float top, float bottom, int yPosSt = 0, int yPosEnd = HEIGHT, bool blur = false, bool writeImage = true);
+	void compute_fractal_compact(const std::string& name, float left, float right, float top, float bottom, bool blur = false, bool equalise = false, bool writeImage = true);
+	void compute_fractal_numa(NumaThreadPool* pool, const std::string& name, float left, float right, float top, float bottom, bool blur = false, int stripeRows = NUMA_STRIPE_ROWS, bool writeImage = true);
+	void compute_fractal_fused(NumaThreadPool* pool, const std::string& name, float left, float right, float top, float bottom, bool blur, const char* filename, int countRows = FUSED_COUNT_ROWS, bool writeImage = true);
 	void applyBlur(uint32_t* inputImage, bool writeImage);
 	void runMultipleTimings();
 	void setUpCSV();
 
 	// GETTERS / SETTERS
+	uint32_t* getImage();
 	int getHeight();
 	int getWidth();
 
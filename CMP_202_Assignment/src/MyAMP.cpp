@@ -2,9 +2,14 @@
 
 /////////////////////////////////////////////////////////////////////////////////////////////
 
+#include <windows.h>
+#include <intrin.h>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
+#include <thread>
+#include <vector>
 
 /////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -19,10 +24,26 @@ std::vector<accelerator> accls = accelerator::get_all();
 
 /////////////////////////////////////////////////////////////////////////////////////////////
 
+// HELPERS
+
+static int countBits(unsigned long long bits)
+{
+	int count = 0;
+
+	for (; bits != 0; bits &= bits - 1)
+	{
+		++count;
+	}
+
+	return count;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
 // CONSTRUCTOR / DESTRUCTOR
 MyAMP::MyAMP()
 {
-
+	probe_CPU();
 }
 
 MyAMP::~MyAMP()
@@ -57,6 +78,7 @@ void MyAMP::list_accelerators()
 	for (int i = 0; i < accls.size(); i++)
 	{
 		accelerator a = accls[i];
+		std::cout << "	[" << i << "]";
 		report_accelerator(a);
 	}
 }
@@ -77,6 +99,9 @@ void MyAMP::query_AMP_support()
 		cout << "Accelerators found that are compatible with C++ AMP" << std::endl;
 		list_accelerators();
 	}
+
+	// The CPU backends don't need AMP at all, so say what they have to work with as well.
+	report_CPU();
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////
@@ -92,4 +117,153 @@ void MyAMP::printAccelInUse()
 	std::cout << "\n##############################################################\n";
 }
 
-/////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Fill in cpu with the instruction sets from CPUID and the core, cache and NUMA layout from Windows.
+void MyAMP::probe_CPU()
+{
+	cpu = CpuCapabilities();
+
+	int info[4] = { 0 };
+
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	cpu.sse2 = (info[3] & (1 << 26)) != 0;
+	cpu.sse41 = (info[2] & (1 << 19)) != 0;
+	cpu.sse42 = (info[2] & (1 << 20)) != 0;
+	cpu.fma = (info[2] & (1 << 12)) != 0;
+
+	// AVX needs the OS to save the YMM registers on a context switch (OSXSAVE, then XCR0 bits 1 and 2).
+	bool osSavesYmm = (info[2] & (1 << 27)) && ((_xgetbv(0) & 0x6) == 0x6);
+	bool osSavesZmm = osSavesYmm && ((_xgetbv(0) & 0xE6) == 0xE6);
+	cpu.avx = osSavesYmm && (info[2] & (1 << 28));
+	cpu.fma = cpu.fma && cpu.avx;
+
+	if (maxLeaf >= 7)
+	{
+		__cpuidex(info, 7, 0);
+		cpu.avx2 = cpu.avx && (info[1] & (1 << 5));
+		cpu.avx512f = osSavesZmm && (info[1] & (1 << 16));
+	}
+
+	// The brand string is spread over three extended leaves, 16 characters each.
+	__cpuid(info, 0x80000000);
+
+	if ((unsigned int)info[0] >= 0x80000004)
+	{
+		char brand[49] = { 0 };
+
+		for (int i = 0; i < 3; ++i)
+		{
+			__cpuid(info, 0x80000002 + i);
+			memcpy(brand + (i * 16), info, 16);
+		}
+
+		cpu.brand = brand;
+		cpu.brand.erase(0, cpu.brand.find_first_not_of(' '));
+	}
+
+	// Ask for the size first, then fill the buffer.
+	DWORD length = 0;
+	GetLogicalProcessorInformationEx(RelationAll, NULL, &length);
+
+	std::vector<uint8_t> buffer(length);
+	PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX pInfo = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)buffer.data();
+
+	if (length > 0 && GetLogicalProcessorInformationEx(RelationAll, pInfo, &length))
+	{
+		// The entries are different sizes, each one says how far it is to the next.
+		for (DWORD offset = 0; offset < length; offset += pInfo->Size)
+		{
+			pInfo = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)(buffer.data() + offset);
+
+			if (pInfo->Relationship == RelationProcessorCore)
+			{
+				++cpu.physicalCores;
+
+				for (int g = 0; g < pInfo->Processor.GroupCount; ++g)
+				{
+					cpu.logicalProcessors += countBits(pInfo->Processor.GroupMask[g].Mask);
+				}
+			}
+			else if (pInfo->Relationship == RelationNumaNode)
+			{
+				++cpu.numaNodes;
+			}
+			else if (pInfo->Relationship == RelationCache)
+			{
+				int sizeKb = (int)(pInfo->Cache.CacheSize / 1024);
+
+				if (pInfo->Cache.Level == 1 && pInfo->Cache.Type != CacheInstruction)
+				{
+					cpu.l1DataKb = sizeKb;
+				}
+				else if (pInfo->Cache.Level == 2)
+				{
+					cpu.l2Kb = sizeKb;
+					++cpu.numL2;
+				}
+				else if (pInfo->Cache.Level == 3)
+				{
+					cpu.l3Kb = sizeKb;
+					++cpu.numL3;
+				}
+			}
+		}
+	}
+
+	// If Windows wouldn't tell us, fall back to what the standard library thinks.
+	if (cpu.logicalProcessors == 0)
+	{
+		cpu.logicalProcessors = (int)std::thread::hardware_concurrency();
+	}
+
+	if (cpu.physicalCores == 0)
+	{
+		cpu.physicalCores = cpu.logicalProcessors;
+	}
+
+	if (cpu.numaNodes == 0)
+	{
+		cpu.numaNodes = 1;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+void MyAMP::report_CPU()
+{
+	const std::string bs[2] = { "false", "true" };
+
+	std::cout << "\nCPU: " << cpu.brand
+		<< endl << "		logical processors                = " << cpu.logicalProcessors
+		<< endl << "		physical cores                    = " << cpu.physicalCores
+		<< endl << "		NUMA nodes                        = " << cpu.numaNodes
+		<< endl << "		L1 data cache                     = " << cpu.l1DataKb << " Kb"
+		<< endl << "		L2 cache                          = " << cpu.l2Kb << " Kb x " << cpu.numL2
+		<< endl << "		L3 cache                          = " << cpu.l3Kb << " Kb x " << cpu.numL3
+		<< endl << "		SSE2 / SSE4.1 / SSE4.2            = " << bs[cpu.sse2] << " / " << bs[cpu.sse41] << " / " << bs[cpu.sse42]
+		<< endl << "		AVX / AVX2 / FMA                  = " << bs[cpu.avx] << " / " << bs[cpu.avx2] << " / " << bs[cpu.fma]
+		<< endl << "		AVX-512F                          = " << bs[cpu.avx512f]
+		<< endl;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// True if the default accelerator is a real device rather than the reference or WARP software emulators.
+bool MyAMP::hasHardwareAccelerator()
+{
+	return !accls.empty() && !accelerator().is_emulated;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// GETTERS / SETTERS
+const CpuCapabilities& MyAMP::getCpuCapabilities()
+{
+	return cpu;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
@@ -1,5 +1,6 @@
 #pragma once
 #include <amp.h>
+#include <string>
 
 /////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -7,6 +8,34 @@ using namespace concurrency;
 
 /////////////////////////////////////////////////////////////////////////////////////////////
 
+// What the CPU we're running on can do, filled in by MyAMP::probe_CPU.
+struct CpuCapabilities
+{
+	std::string brand;
+
+	// Instruction set extensions, the AVX ones are only set if the OS saves the wider registers too.
+	bool sse2;
+	bool sse41;
+	bool sse42;
+	bool avx;
+	bool avx2;
+	bool fma;
+	bool avx512f;
+
+	int logicalProcessors;
+	int physicalCores;
+	int numaNodes;
+
+	// Size of one of each cache in Kb, and how many of them there are.
+	int l1DataKb;
+	int l2Kb;
+	int l3Kb;
+	int numL2;
+	int numL3;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
 class MyAMP
 {
 public:
@@ -18,8 +47,15 @@ public:
 	void query_AMP_support();
 	void printAccelInUse();
 
-private:
+	void probe_CPU();
+	void report_CPU();
+	bool hasHardwareAccelerator();
 
+	// GETTERS / SETTERS
+	const CpuCapabilities& getCpuCapabilities();
+
+private:
+	CpuCapabilities cpu;
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
@@ -0,0 +1,340 @@
+#include "NumaThreadPool.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <windows.h>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+using std::cout;
+using std::endl;
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// CONSTRUCTOR / DESTRUCTOR
+NumaThreadPool::NumaThreadPool(int numThreads)
+{
+	detectTopology();
+
+	if (numThreads <= 0)
+	{
+		numThreads = (int)std::thread::hardware_concurrency();
+	}
+
+	this->numThreads = (numThreads > 0) ? numThreads : 1;
+
+	resetCounters();
+
+	int numNodes = (int)nodes.size();
+
+	pTask = nullptr;
+	allowStealing = false;
+	bytesPerStripe = 0;
+	firstStripe.resize(numNodes + 1);
+	nextStripe.reset(new std::atomic<int>[numNodes]);
+	jobGeneration = 0;
+	workersBusy = 0;
+	stopping = false;
+
+	// Make sure every node gets at least one thread, otherwise its stripes would never run without stealing.
+	int threadsToStart = (this->numThreads > numNodes) ? this->numThreads : numNodes;
+
+	for (int t = 0; t < threadsToStart; ++t)
+	{
+		workers.push_back(std::thread(&NumaThreadPool::workerLoop, this, t % numNodes));
+	}
+}
+
+NumaThreadPool::~NumaThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	jobReady.notify_all();
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// FUNCTIONS
+
+// Ask Windows which processors are on which node, if anything fails we treat the machine as a single node.
+void NumaThreadPool::detectTopology()
+{
+	nodes.clear();
+
+	ULONG highestNode = 0;
+
+	if (GetNumaHighestNodeNumber(&highestNode))
+	{
+		for (ULONG n = 0; n <= highestNode; ++n)
+		{
+			GROUP_AFFINITY affinity{};
+
+			if (!GetNumaNodeProcessorMaskEx((USHORT)n, &affinity) || affinity.Mask == 0)
+			{
+				// Node numbers can have gaps, or a node can be memory only.
+				continue;
+			}
+
+			NumaNode node{};
+			node.group = affinity.Group;
+			node.mask = affinity.Mask;
+
+			for (unsigned long long bits = node.mask; bits != 0; bits &= bits - 1)
+			{
+				++node.numProcessors;
+			}
+
+			nodes.push_back(node);
+		}
+	}
+
+	if (nodes.empty())
+	{
+		NumaNode node{};
+		node.group = 0;
+		node.mask = 0;		// 0 means don't pin.
+		node.numProcessors = (int)std::thread::hardware_concurrency();
+		nodes.push_back(node);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Lock the calling thread to the processors of one node, memory it first touches will then be local to that node.
+void NumaThreadPool::pinToNode(int node)
+{
+	if (nodes[node].mask == 0)
+	{
+		return;
+	}
+
+	GROUP_AFFINITY affinity{};
+	affinity.Group = nodes[node].group;
+	affinity.Mask = (KAFFINITY)nodes[node].mask;
+
+	SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Each node owns a contiguous block of stripes, so the rows each node writes are next to each other.
+// This is the first stripe in node's block, the block ends where the next node's starts.
+int NumaThreadPool::firstStripeOf(int node, int numStripes)
+{
+	return (int)(((long long)node * numStripes) / (long long)nodes.size());
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+int NumaThreadPool::ownerNode(int stripe, int numStripes)
+{
+	int node = 0;
+
+	while (node + 1 < (int)nodes.size() && firstStripeOf(node + 1, numStripes) <= stripe)
+	{
+		++node;
+	}
+
+	return node;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Each worker pins itself once and then sleeps until there's a job, so a render doesn't pay for starting threads.
+void NumaThreadPool::workerLoop(int node)
+{
+	pinToNode(node);
+
+	int seenGeneration = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobReady.wait(lock, [&]() { return stopping || jobGeneration != seenGeneration; });
+
+			if (stopping)
+			{
+				return;
+			}
+
+			seenGeneration = jobGeneration;
+		}
+
+		runStripes(node);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			if (--workersBusy == 0)
+			{
+				jobDone.notify_all();
+			}
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// One worker's share of the current job.
+void NumaThreadPool::runStripes(int node)
+{
+	int numNodes = (int)nodes.size();
+
+	// Local stripes first.
+	for (int s = nextStripe[node]++; s < firstStripe[node + 1]; s = nextStripe[node]++)
+	{
+		(*pTask)(s, node);
+		++localStripes;
+	}
+
+	if (!allowStealing)
+	{
+		return;
+	}
+
+	// Then help out the other nodes, nearest numbered first.
+	for (int i = 1; i < numNodes; ++i)
+	{
+		int other = (node + i) % numNodes;
+
+		for (int s = nextStripe[other]++; s < firstStripe[other + 1]; s = nextStripe[other]++)
+		{
+			(*pTask)(s, node);
+			++remoteStripes;
+			remoteBytes += (long long)bytesPerStripe;
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Run task(stripe, node) for every stripe on the pinned workers, and wait for them all to finish.
+// node is the node of the worker running it, which is not the stripe's owner when it has been stolen.
+// With allowStealing off a stripe is only ever run on its own node, which is what first touch needs.
+void NumaThreadPool::forEachStripe(int numStripes, size_t bytesPerStripe, bool allowStealing, const std::function<void(int stripe, int node)>& task)
+{
+	std::lock_guard<std::mutex> callLock(callMutex);
+
+	int numNodes = (int)nodes.size();
+
+	for (int n = 0; n <= numNodes; ++n)
+	{
+		firstStripe[n] = firstStripeOf(n, numStripes);
+	}
+
+	for (int n = 0; n < numNodes; ++n)
+	{
+		nextStripe[n] = firstStripe[n];
+	}
+
+	this->pTask = &task;
+	this->allowStealing = allowStealing;
+	this->bytesPerStripe = bytesPerStripe;
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	workersBusy = (int)workers.size();
+	++jobGeneration;
+	jobReady.notify_all();
+
+	jobDone.wait(lock, [&]() { return workersBusy == 0; });
+
+	pTask = nullptr;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// For passes that read another node's stripes, e.g. the blur halo, which forEachStripe can't see.
+void NumaThreadPool::addRemoteBytes(long long bytes)
+{
+	remoteBytes += bytes;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+void NumaThreadPool::resetCounters()
+{
+	localStripes = 0;
+	remoteStripes = 0;
+	remoteBytes = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+void NumaThreadPool::reportCounters()
+{
+	long long total = localStripes + remoteStripes;
+
+	cout << "NUMA nodes: " << nodes.size() << ", threads: " << numThreads << endl;
+	cout << "Stripes run on their own node: " << localStripes << " / " << total
+		<< ", stolen by another node: " << remoteStripes
+		<< ", " << remoteBytes / 1024 << " Kb moved cross node" << endl;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// GETTERS / SETTERS
+int NumaThreadPool::getNumThreads()
+{
+	return numThreads;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// CONSTRUCTOR / DESTRUCTOR
+NumaFrame::NumaFrame(NumaThreadPool* pool, int numStripes, size_t bytesPerStripe)
+{
+	this->bytesPerStripe = bytesPerStripe;
+	stripes.resize(numStripes, nullptr);
+
+	// Reserve and commit the address space here, no physical pages are handed out until they're written.
+	for (int s = 0; s < numStripes; ++s)
+	{
+		stripes[s] = (uint32_t*)VirtualAlloc(NULL, bytesPerStripe, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+		if (!stripes[s])
+		{
+			cout << "Failed to allocate frame stripe " << s << ", error " << GetLastError() << endl;
+			exit(1);
+		}
+	}
+
+	// First touch, each stripe is zeroed by a thread on its owning node and nowhere else.
+	pool->forEachStripe(numStripes, bytesPerStripe, false, [&](int s, int)
+		{
+			memset(stripes[s], 0, bytesPerStripe);
+		});
+}
+
+NumaFrame::~NumaFrame()
+{
+	for (uint32_t* pStripe : stripes)
+	{
+		if (pStripe)
+		{
+			VirtualFree(pStripe, 0, MEM_RELEASE);
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// FUNCTIONS
+uint32_t* NumaFrame::stripe(int s)
+{
+	return stripes[s];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,104 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// The processors belonging to one NUMA node, kept as plain types so windows.h stays out of the header.
+struct NumaNode
+{
+	unsigned short group;		// Processor group, only matters on machines with more than 64 logical processors.
+	unsigned long long mask;	// Which processors in the group are on this node.
+	int numProcessors;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * CPU thread pool that knows which NUMA node each thread is on.
+ *
+ * The worker threads are started and pinned to their node once, in the constructor, and then
+ * sleep until forEachStripe gives them a job. Work is handed out as stripes of the image. Each
+ * stripe is owned by one node (the nodes get a contiguous block of stripes each) and threads
+ * pinned to a node take that node's stripes first. Once a node runs out it steals from the others
+ * so no one sits idle, and every steal is counted as cross node traffic so we can see how much
+ * remote memory is being written. The task is told which node the thread running it is on, so
+ * anything it reads from other stripes can be counted against the right node too.
+ *
+ * Only one job runs at a time, and a task must not call forEachStripe on the same pool.
+ */
+class NumaThreadPool
+{
+public:
+	NumaThreadPool(int numThreads = 0);
+	~NumaThreadPool();
+
+	void forEachStripe(int numStripes, size_t bytesPerStripe, bool allowStealing, const std::function<void(int stripe, int node)>& task);
+	int ownerNode(int stripe, int numStripes);
+	void addRemoteBytes(long long bytes);
+	void resetCounters();
+	void reportCounters();
+
+	// GETTERS / SETTERS
+	int getNumThreads();
+
+private:
+	void detectTopology();
+	int firstStripeOf(int node, int numStripes);
+	void pinToNode(int node);
+	void workerLoop(int node);
+	void runStripes(int node);
+
+	std::vector<NumaNode> nodes;
+	int numThreads;
+	std::vector<std::thread> workers;
+
+	// The job being run, only changed by forEachStripe while every worker is asleep.
+	const std::function<void(int stripe, int node)>* pTask;
+	bool allowStealing;
+	size_t bytesPerStripe;
+	std::vector<int> firstStripe;						// The range of stripes each node owns,
+	std::unique_ptr<std::atomic<int>[]> nextStripe;		// and the next one in that range to hand out.
+
+	// Wakes the workers when there's a new job, and forEachStripe when they've all finished it.
+	std::mutex callMutex;
+	std::mutex mutex;
+	std::condition_variable jobReady;
+	std::condition_variable jobDone;
+	int jobGeneration;
+	int workersBusy;
+	bool stopping;
+
+	// Cross node traffic counters, added to by every call to forEachStripe.
+	std::atomic<long long> localStripes;
+	std::atomic<long long> remoteStripes;
+	std::atomic<long long> remoteBytes;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * A frame buffer split in to one allocation per stripe.
+ * Windows doesn't back committed pages with physical memory until they are first written,
+ * so each stripe is zeroed by a thread on the node that owns it, which puts its pages in that node's memory.
+ */
+class NumaFrame
+{
+public:
+	NumaFrame(NumaThreadPool* pool, int numStripes, size_t bytesPerStripe);
+	~NumaFrame();
+
+	uint32_t* stripe(int s);
+
+private:
+	std::vector<uint32_t*> stripes;
+	size_t bytesPerStripe;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////
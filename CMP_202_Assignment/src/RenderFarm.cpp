@@ -0,0 +1,450 @@
+// Winsock has to come in before anything pulls in windows.h (amp.h does, through Mandlebrot.h),
+// otherwise we get the old winsock.h definitions.
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include "RenderFarm.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#pragma comment(lib, "Ws2_32.lib")
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+using std::cout;
+using std::endl;
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// GLOBALS
+typedef std::chrono::steady_clock the_clock;
+
+// The coordinators view of a connected worker process.
+struct WorkerConn
+{
+	SOCKET sock;
+	bool busy;		// True while the worker has a stripe it hasn't sent back yet.
+	StripeJob job;
+	the_clock::time_point dispatched;	// When it was given job, so a worker that hangs can be timed out.
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// HELPERS
+
+// send() and recv() on a stream socket can move less than we asked for, so keep going until it's all moved.
+static bool sendAll(SOCKET sock, const char* data, int numBytes)
+{
+	while (numBytes > 0)
+	{
+		int sent = send(sock, data, numBytes, 0);
+
+		if (sent == SOCKET_ERROR || sent == 0)
+		{
+			return false;
+		}
+
+		data += sent;
+		numBytes -= sent;
+	}
+
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool recvAll(SOCKET sock, char* data, int numBytes)
+{
+	while (numBytes > 0)
+	{
+		int received = recv(sock, data, numBytes, 0);
+
+		// 0 means the other end closed the connection, SOCKET_ERROR covers it crashing or timing out.
+		if (received == SOCKET_ERROR || received == 0)
+		{
+			return false;
+		}
+
+		data += received;
+		numBytes -= received;
+	}
+
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// CONSTRUCTOR / DESTRUCTOR
+RenderFarm::RenderFarm(Mandlebrot* mandle)
+{
+	mandlebrot = mandle;
+	stripesDone = 0;
+}
+
+RenderFarm::~RenderFarm()
+{
+
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// FUNCTIONS
+
+// Launch copies of this executable in worker mode, pointed back at the coordinator on localhost.
+void RenderFarm::spawnLocalWorkers(int numWorkers, unsigned short port)
+{
+	char exePath[MAX_PATH];
+	GetModuleFileNameA(NULL, exePath, MAX_PATH);
+
+	for (int i = 0; i < numWorkers; ++i)
+	{
+		std::string cmdLine = "\"" + std::string(exePath) + "\" --worker 127.0.0.1 " + std::to_string(port);
+
+		STARTUPINFOA startInfo{};
+		startInfo.cb = sizeof(startInfo);
+		PROCESS_INFORMATION procInfo{};
+
+		if (!CreateProcessA(NULL, &cmdLine[0], NULL, NULL, FALSE, 0, NULL, NULL, &startInfo, &procInfo))
+		{
+			cout << "Failed to launch worker " << i << ", error " << GetLastError() << endl;
+			continue;
+		}
+
+		// We don't need to keep hold of the worker, if it dies the coordinator finds out through its socket.
+		CloseHandle(procInfo.hThread);
+		CloseHandle(procInfo.hProcess);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Split the image in to horizontal stripes of (roughly) equal height.
+// The last stripe picks up any rows left over when HEIGHT doesn't divide evenly.
+void RenderFarm::createStripes(float left, float right, float top, float bottom, int numStripes)
+{
+	pendingStripes.clear();
+
+	int rowsPerStripe = HEIGHT / numStripes;
+
+	for (int i = 0; i < numStripes; ++i)
+	{
+		StripeJob job{};
+		job.stripeId = i;
+		job.yPosSt = i * rowsPerStripe;
+		job.yPosEnd = (i == numStripes - 1) ? HEIGHT : job.yPosSt + rowsPerStripe;
+		job.left = left;
+		job.right = right;
+		job.top = top;
+		job.bottom = bottom;
+
+		pendingStripes.push_back(job);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Used when every worker has gone away, the rows end up in the same image either way.
+void RenderFarm::renderStripeLocally(const StripeJob& job)
+{
+	mandlebrot->compute_mandelbrot_with_AMP(job.left, job.right, job.top, job.bottom, job.yPosSt, job.yPosEnd, false, false);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Listens on localhost unless bindAddress is given, anything that connects gets to write straight in to the image.
+void RenderFarm::runCoordinator(float left, float right, float top, float bottom, int numStripes, unsigned short port, bool blur, const char* bindAddress)
+{
+	if (numStripes < 1 || numStripes > HEIGHT)
+	{
+		cout << "Number of stripes must be between 1 and " << HEIGHT << endl;
+		return;
+	}
+
+	WSADATA wsaData;
+
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+	{
+		cout << "Failed to start Winsock" << endl;
+		return;
+	}
+
+	createStripes(left, right, top, bottom, numStripes);
+	stripesDone = 0;
+
+	SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+	sockaddr_in addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+
+	if (bindAddress && inet_pton(AF_INET, bindAddress, &addr.sin_addr) != 1)
+	{
+		cout << "Not a valid IPv4 address to listen on: " << bindAddress << endl;
+		closesocket(listener);
+		WSACleanup();
+		return;
+	}
+
+	if (listener == INVALID_SOCKET
+		|| bind(listener, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR
+		|| listen(listener, SOMAXCONN) == SOCKET_ERROR)
+	{
+		cout << "Coordinator failed to listen on port " << port << ", error " << WSAGetLastError() << endl;
+		closesocket(listener);
+		WSACleanup();
+		return;
+	}
+
+	cout << "Coordinator listening on " << (bindAddress ? bindAddress : "127.0.0.1") << ":" << port << " with " << numStripes << " stripes to hand out" << endl;
+
+	std::vector<WorkerConn> workers;
+	the_clock::time_point lastWorkerSeen = the_clock::now();
+
+	while (stripesDone < numStripes)
+	{
+		// Hand out the next stripe to anyone who is sat idle.
+		for (size_t i = 0; i < workers.size() && !pendingStripes.empty(); ++i)
+		{
+			if (workers[i].busy)
+			{
+				continue;
+			}
+
+			workers[i].job = pendingStripes.front();
+			pendingStripes.pop_front();
+
+			if (sendAll(workers[i].sock, (const char*)&workers[i].job, sizeof(StripeJob)))
+			{
+				workers[i].busy = true;
+				workers[i].dispatched = the_clock::now();
+			}
+			else
+			{
+				// Worker vanished before we could even give it the job, put it back for someone else.
+				// The dead socket gets cleaned up below when select reports it.
+				pendingStripes.push_front(workers[i].job);
+			}
+		}
+
+		fd_set readSet;
+		FD_ZERO(&readSet);
+		FD_SET(listener, &readSet);
+
+		for (const WorkerConn& worker : workers)
+		{
+			FD_SET(worker.sock, &readSet);
+		}
+
+		// Wake up at least once a second so we can notice when every worker has gone.
+		timeval waitTime{ 1, 0 };
+
+		if (select(0, &readSet, NULL, NULL, &waitTime) == SOCKET_ERROR)
+		{
+			cout << "select() failed, error " << WSAGetLastError() << endl;
+			break;
+		}
+
+		// New worker connecting.
+		if (FD_ISSET(listener, &readSet) && workers.size() < FD_SETSIZE - 1)
+		{
+			SOCKET workerSock = accept(listener, NULL, NULL);
+
+			if (workerSock != INVALID_SOCKET)
+			{
+				// A worker that stops sending part way through a stripe is treated the same as one that crashed.
+				DWORD timeout = WORKER_TIMEOUT_MS;
+				setsockopt(workerSock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+
+				WorkerConn worker{};
+				worker.sock = workerSock;
+				worker.busy = false;
+				workers.push_back(worker);
+
+				cout << "Worker connected, " << workers.size() << " in the farm" << endl;
+			}
+		}
+
+		// Collect finished stripes, anything else readable is a worker that has died.
+		for (size_t i = 0; i < workers.size();)
+		{
+			WorkerConn& worker = workers[i];
+
+			if (!FD_ISSET(worker.sock, &readSet))
+			{
+				++i;
+				continue;
+			}
+
+			StripeResultHeader header{};
+			bool ok = worker.busy && recvAll(worker.sock, (char*)&header, sizeof(header));
+
+			// Make sure it is actually the stripe we gave it before we let it write in to the image.
+			ok = ok && header.stripeId == worker.job.stripeId
+				&& header.yPosSt == worker.job.yPosSt
+				&& header.yPosEnd == worker.job.yPosEnd;
+
+			if (ok)
+			{
+				uint32_t* pRows = mandlebrot->getImage() + (header.yPosSt * WIDTH);
+				int numBytes = (header.yPosEnd - header.yPosSt) * WIDTH * sizeof(uint32_t);
+
+				ok = recvAll(worker.sock, (char*)pRows, numBytes);
+			}
+
+			if (!ok)
+			{
+				if (worker.busy)
+				{
+					cout << "Worker lost, reassigning stripe " << worker.job.stripeId << endl;
+					pendingStripes.push_front(worker.job);
+				}
+
+				closesocket(worker.sock);
+				workers.erase(workers.begin() + i);
+				continue;
+			}
+
+			worker.busy = false;
+			++stripesDone;
+			++i;
+		}
+
+		// SO_RCVTIMEO only kicks in once a worker has started sending, one that hangs mid render
+		// with its connection still open never becomes readable, so time the stripe out here.
+		for (size_t i = 0; i < workers.size();)
+		{
+			WorkerConn& worker = workers[i];
+
+			if (!worker.busy || std::chrono::duration_cast<std::chrono::milliseconds>(the_clock::now() - worker.dispatched).count() <= WORKER_TIMEOUT_MS)
+			{
+				++i;
+				continue;
+			}
+
+			cout << "Worker timed out, reassigning stripe " << worker.job.stripeId << endl;
+			pendingStripes.push_front(worker.job);
+
+			closesocket(worker.sock);
+			workers.erase(workers.begin() + i);
+		}
+
+		if (!workers.empty())
+		{
+			lastWorkerSeen = the_clock::now();
+		}
+		else if (std::chrono::duration_cast<std::chrono::milliseconds>(the_clock::now() - lastWorkerSeen).count() > WORKER_TIMEOUT_MS)
+		{
+			// Nobody is left to do the work, so finish the image off ourselves rather than hang forever.
+			cout << "No workers available, rendering the remaining " << pendingStripes.size() << " stripes locally" << endl;
+
+			while (!pendingStripes.empty())
+			{
+				renderStripeLocally(pendingStripes.front());
+				pendingStripes.pop_front();
+				++stripesDone;
+			}
+		}
+	}
+
+	// Tell every worker still connected that we're done.
+	StripeJob stopJob{};
+	stopJob.stripeId = -1;
+
+	for (const WorkerConn& worker : workers)
+	{
+		sendAll(worker.sock, (const char*)&stopJob, sizeof(StripeJob));
+		closesocket(worker.sock);
+	}
+
+	closesocket(listener);
+	WSACleanup();
+
+	if (stripesDone < numStripes)
+	{
+		cout << "Render farm stopped with " << (numStripes - stripesDone) << " stripes unfinished" << endl;
+		return;
+	}
+
+	// Every stripe is now in the image, so write it out exactly as a single process render would.
+	mandlebrot->write_tga("original_image.tga", false);
+
+	if (blur)
+	{
+		mandlebrot->applyBlur(mandlebrot->getImage(), true);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderFarm::runWorker(const std::string& host, unsigned short port)
+{
+	WSADATA wsaData;
+
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+	{
+		cout << "Failed to start Winsock" << endl;
+		return;
+	}
+
+	sockaddr_in addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	inet_pton(AF_INET, host.c_str(), &addr.sin_addr);
+
+	SOCKET sock = INVALID_SOCKET;
+
+	// The coordinator may still be starting up when we get launched, so give it a few seconds.
+	for (int attempt = 0; attempt < 40 && sock == INVALID_SOCKET; ++attempt)
+	{
+		sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+		if (connect(sock, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR)
+		{
+			closesocket(sock);
+			sock = INVALID_SOCKET;
+			Sleep(250);
+		}
+	}
+
+	if (sock == INVALID_SOCKET)
+	{
+		cout << "Worker could not connect to " << host << ":" << port << endl;
+		WSACleanup();
+		return;
+	}
+
+	StripeJob job{};
+
+	// Keep taking stripes until we're told to stop or the coordinator goes away.
+	while (recvAll(sock, (char*)&job, sizeof(job)) && job.stripeId >= 0)
+	{
+		if (job.yPosSt < 0 || job.yPosEnd > HEIGHT || job.yPosSt >= job.yPosEnd)
+		{
+			break;
+		}
+
+		mandlebrot->compute_mandelbrot_with_AMP(job.left, job.right, job.top, job.bottom, job.yPosSt, job.yPosEnd, false, false);
+
+		StripeResultHeader header{};
+		header.stripeId = job.stripeId;
+		header.yPosSt = job.yPosSt;
+		header.yPosEnd = job.yPosEnd;
+
+		const uint32_t* pRows = mandlebrot->getImage() + (job.yPosSt * WIDTH);
+		int numBytes = (job.yPosEnd - job.yPosSt) * WIDTH * sizeof(uint32_t);
+
+		if (!sendAll(sock, (const char*)&header, sizeof(header)) || !sendAll(sock, (const char*)pRows, numBytes))
+		{
+			break;
+		}
+	}
+
+	closesocket(sock);
+	WSACleanup();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,68 @@
+#pragma once
+#include "Mandlebrot.h"
+#include <deque>
+#include <string>
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// The default port the coordinator listens on for workers, on localhost only unless runCoordinator is given an address.
+const unsigned short FARM_PORT = 27202;
+
+// How long a worker gets to send back a stripe before it is assumed to have died or hung, in milliseconds.
+const int WORKER_TIMEOUT_MS = 30000;
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// A single horizontal stripe of the image to be rendered by a worker.
+// Sent as-is over the socket, as are the rows of pixels that come back, so there's no byte order or padding
+// conversion. Workers on other machines have to run the identical build (same WIDTH and HEIGHT too) on the
+// same architecture as the coordinator, which is always the case for the local workers it spawns itself.
+struct StripeJob
+{
+	int stripeId;	// -1 tells the worker there is no more work and it should shut down.
+	int yPosSt;
+	int yPosEnd;
+	float left;
+	float right;
+	float top;
+	float bottom;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Sent back by the worker in front of the rows of pixels it has rendered.
+struct StripeResultHeader
+{
+	int stripeId;
+	int yPosSt;
+	int yPosEnd;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Splits the image in to stripes and hands them out on demand to worker processes over TCP.
+ * Workers are just this same executable run with --worker, they render their stripe using
+ * compute_mandelbrot_with_AMP and send the rows back to be assembled in to the final image.
+ * If a worker dies, or stops responding, the stripe it was working on goes back in the queue.
+ */
+class RenderFarm
+{
+public:
+	RenderFarm(Mandlebrot* mandle);
+	~RenderFarm();
+
+	void spawnLocalWorkers(int numWorkers, unsigned short port);
+	void runCoordinator(float left, float right, float top, float bottom, int numStripes, unsigned short port, bool blur, const char* bindAddress = nullptr);
+	void runWorker(const std::string& host, unsigned short port);
+
+private:
+	void createStripes(float left, float right, float top, float bottom, int numStripes);
+	void renderStripeLocally(const StripeJob& job);
+
+	Mandlebrot* mandlebrot;
+	std::deque<StripeJob> pendingStripes;
+	int stripesDone;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////
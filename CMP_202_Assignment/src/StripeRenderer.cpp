@@ -0,0 +1,154 @@
+#include "StripeRenderer.h"
+#include "ColourPipeline.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+using std::cout;
+using std::endl;
+using std::ofstream;
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// CONSTRUCTOR / DESTRUCTOR
+StripeRenderer::StripeRenderer(int width, int height, int stripeRows)
+{
+	this->width = width;
+	this->height = height;
+	this->stripeRows = std::max(1, std::min(stripeRows, height));
+}
+
+StripeRenderer::~StripeRenderer()
+{
+
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// FUNCTIONS
+
+// Roughly what we hold on the CPU at once, the two stripe buffers plus the rows inside the ColourPipeline.
+// The accelerator holds another copy of the stripe it's working on.
+size_t StripeRenderer::estimatePeakBytes(int countsPerWord)
+{
+	size_t wordsPerRow = (width + countsPerWord - 1) / countsPerWord;
+	size_t stripeBytes = 2 * (size_t)stripeRows * wordsPerRow * sizeof(uint32_t);
+	size_t pipelineBytes = (size_t)(KERNEL_SIZE + 3) * width * 3 * sizeof(float);
+
+	return stripeBytes + pipelineBytes;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+bool StripeRenderer::render(const std::string& name, float left, float right, float top, float bottom, bool blur, const char* filename)
+{
+	const FractalVariant* variant = FractalRegistry::findOrList(name);
+
+	if (!variant)
+	{
+		return false;
+	}
+
+	// The TGA header only has 16 bits for each dimension.
+	if (width < 1 || height < 1 || width > 0xFFFF || height > 0xFFFF)
+	{
+		cout << "Image size must be between 1 and 65535 in each direction for a TGA" << endl;
+		return false;
+	}
+
+	std::vector<Colour> lut = palette.createIterationLUT(variant->maxIterations);
+	ColourPipeline pipeline(width, height, lut, variant->countsPerWord, blur);
+
+	int wordsPerRow = pipeline.getWordsPerRow();
+	int numStripes = (height + stripeRows - 1) / stripeRows;
+
+	cout << "Rendering " << width << "x" << height << " in " << numStripes << " stripes of " << stripeRows
+		<< " rows, using about " << estimatePeakBytes(variant->countsPerWord) / (1024 * 1024) << " Mb" << endl;
+
+	// Double buffered, the accelerator fills one while the other is being written out.
+	std::vector<uint32_t> stripeBuffers[2];
+	stripeBuffers[0].resize((size_t)stripeRows * wordsPerRow);
+	stripeBuffers[1].resize((size_t)stripeRows * wordsPerRow);
+
+	array_view<uint32_t, 2> stripeViews[2] = {
+		array_view<uint32_t, 2>(stripeRows, wordsPerRow, stripeBuffers[0].data()),
+		array_view<uint32_t, 2>(stripeRows, wordsPerRow, stripeBuffers[1].data()),
+	};
+
+	ofstream outfile(filename, ofstream::binary);
+	ColourPipeline::writeHeader(outfile, width, height);
+
+	FractalView view;
+	view.left = left;
+	view.right = right;
+	view.top = top;
+	view.bottom = bottom;
+	view.frameWidth = width;
+	view.frameHeight = height;
+	view.seed = variant->seed;
+
+	int prevRows = 0;
+
+	try
+	{
+		for (int s = 0; s < numStripes; ++s)
+		{
+			int cur = s % 2;
+			int numRows = std::min(stripeRows, height - (s * stripeRows));
+
+			// The last stripe may be short, so only hand the kernel the rows that are actually in the image.
+			array_view<uint32_t, 2> stripeView = stripeViews[cur].section(index<2>(0, 0), extent<2>(numRows, wordsPerRow));
+			stripeView.discard_data();
+
+			// parallel_for_each returns straight away, so the kernel runs while we write out the previous stripe.
+			view.yPosSt = s * stripeRows;
+			variant->countKernel(stripeView, view);
+
+			if (s > 0)
+			{
+				const uint32_t* pPrev = stripeBuffers[1 - cur].data();
+
+				for (int y = 0; y < prevRows; ++y)
+				{
+					pipeline.pushRow(pPrev + ((size_t)y * wordsPerRow), outfile);
+				}
+			}
+
+			stripeView.synchronize();
+			prevRows = numRows;
+		}
+	}
+	catch (const concurrency::runtime_exception& ex)
+	{
+		MessageBoxA(NULL, ex.what(), "Error with rendering image stripes", MB_ICONERROR);
+		return false;
+	}
+
+	// The last stripe has nothing to overlap with.
+	const uint32_t* pLast = stripeBuffers[(numStripes - 1) % 2].data();
+
+	for (int y = 0; y < prevRows; ++y)
+	{
+		pipeline.pushRow(pLast + ((size_t)y * wordsPerRow), outfile);
+	}
+
+	pipeline.finish(outfile);
+
+	outfile.close();
+	if (!outfile)
+	{
+		// An error has occurred at some point since we opened the file.
+		cout << "Error writing to " << filename << endl;
+		return false;
+	}
+
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
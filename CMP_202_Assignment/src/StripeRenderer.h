@@ -0,0 +1,39 @@
+#pragma once
+#include "ColourPalette.h"
+#include "FractalRegistry.h"
+#include <string>
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// How many rows to render per stripe when not told otherwise.
+const int DEFAULT_STRIPE_ROWS = 256;
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Out of core renderer for images far too big for the static image arrays in Mandlebrot.cpp.
+ * The image is rendered a horizontal stripe at a time in to one of two stripe buffers, while
+ * the accelerator works on the next stripe the previous one is coloured, blurred and appended
+ * to the file by a ColourPipeline. The pipeline keeps the last KERNEL_SIZE rows of colour, so
+ * the blur halo is carried over from one stripe to the next without re-rendering anything.
+ *
+ * Memory use is set by the width and stripeRows only, the height makes no difference.
+ */
+class StripeRenderer
+{
+public:
+	StripeRenderer(int width, int height, int stripeRows = DEFAULT_STRIPE_ROWS);
+	~StripeRenderer();
+
+	bool render(const std::string& name, float left, float right, float top, float bottom, bool blur, const char* filename);
+	size_t estimatePeakBytes(int countsPerWord);
+
+private:
+	int width;
+	int height;
+	int stripeRows;
+
+	ColourPalette palette;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////
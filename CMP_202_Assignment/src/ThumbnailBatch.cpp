@@ -0,0 +1,198 @@
+#include "ThumbnailBatch.h"
+#include "ColourPipeline.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <fstream>
+#include <iostream>
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+using std::cout;
+using std::endl;
+using std::ofstream;
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// CONSTRUCTOR / DESTRUCTOR
+ThumbnailBatch::ThumbnailBatch(const std::string& name)
+{
+	variant = FractalRegistry::findOrList(name);
+}
+
+ThumbnailBatch::~ThumbnailBatch()
+{
+
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// FUNCTIONS
+
+// Queue up a thumbnail and return its index, nothing is rendered until render() is called.
+int ThumbnailBatch::addThumbnail(float left, float right, float top, float bottom, int width, int height)
+{
+	ThumbnailJob job;
+	job.firstPixel = (int)pixels.size();
+	job.width = width;
+	job.height = height;
+	job.left = left;
+	job.right = right;
+	job.top = top;
+	job.bottom = bottom;
+
+	jobs.push_back(job);
+	pixels.resize(pixels.size() + ((size_t)width * height));
+
+	return (int)jobs.size() - 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+void ThumbnailBatch::clear()
+{
+	jobs.clear();
+	pixels.clear();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Render every thumbnail in the batch with one palette, one launch and one synchronize.
+bool ThumbnailBatch::render()
+{
+	if (!variant || jobs.empty())
+	{
+		return false;
+	}
+
+	std::vector<Colour> colPalette = palette.createPalette();
+
+	array_view<uint32_t, 1> pixelView((int)pixels.size(), pixels);
+	array_view<const ThumbnailJob, 1> jobView((int)jobs.size(), jobs);
+	array_view<Colour, 1> paletteArrView(colPalette.size(), colPalette);
+	pixelView.discard_data();
+
+	try
+	{
+		variant->thumbnailKernel(pixelView, jobView, paletteArrView, variant->seed);
+
+		pixelView.synchronize();
+	}
+	catch (const concurrency::runtime_exception& ex)
+	{
+		MessageBoxA(NULL, ex.what(), "Error with rendering thumbnail batch", MB_ICONERROR);
+		return false;
+	}
+
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// The way it was done before batching, a palette, launch and synchronize per thumbnail.
+// Gives exactly the same pixels as render(), it's kept so the two can be timed against each other.
+bool ThumbnailBatch::renderOneAtATime()
+{
+	if (!variant || jobs.empty())
+	{
+		return false;
+	}
+
+	try
+	{
+		for (const ThumbnailJob& job : jobs)
+		{
+			std::vector<Colour> colPalette = palette.createPalette();
+
+			array_view<uint32_t, 2> arrView(job.height, job.width, &pixels[job.firstPixel]);
+			array_view<Colour, 1> paletteArrView(colPalette.size(), colPalette);
+			arrView.discard_data();
+
+			FractalView view;
+			view.left = job.left;
+			view.right = job.right;
+			view.top = job.top;
+			view.bottom = job.bottom;
+			view.frameWidth = job.width;
+			view.frameHeight = job.height;
+			view.yPosSt = 0;
+			view.seed = variant->seed;
+
+			variant->kernel(arrView, paletteArrView, view);
+
+			arrView.synchronize();
+		}
+	}
+	catch (const concurrency::runtime_exception& ex)
+	{
+		MessageBoxA(NULL, ex.what(), "Error with rendering thumbnails one at a time", MB_ICONERROR);
+		return false;
+	}
+
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Same format as Mandlebrot::write_tga, for one thumbnail of the batch.
+bool ThumbnailBatch::write_tga(int thumbnail, const char* filename)
+{
+	const ThumbnailJob& job = jobs[thumbnail];
+	ofstream outfile(filename, ofstream::binary);
+
+	ColourPipeline::writeHeader(outfile, job.width, job.height);
+
+	const uint32_t* pPixels = getPixels(thumbnail);
+
+	for (int i = 0; i < job.width * job.height; ++i)
+	{
+		uint8_t pixel[3] = {
+				 pPixels[i] & 0xFF,			// blue channel
+				(pPixels[i] >> 8) & 0xFF,	// green channel
+				(pPixels[i] >> 16) & 0xFF,	// red channel
+		};
+		outfile.write((const char*)pixel, 3);
+	}
+
+	outfile.close();
+	if (!outfile)
+	{
+		// An error has occurred at some point since we opened the file.
+		cout << "Error writing to " << filename << endl;
+		return false;
+	}
+
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// GETTERS / SETTERS
+int ThumbnailBatch::getNumThumbnails()
+{
+	return (int)jobs.size();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+int ThumbnailBatch::getWidth(int thumbnail)
+{
+	return jobs[thumbnail].width;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+int ThumbnailBatch::getHeight(int thumbnail)
+{
+	return jobs[thumbnail].height;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Only valid after render() or renderOneAtATime(), and until the next addThumbnail or clear.
+const uint32_t* ThumbnailBatch::getPixels(int thumbnail)
+{
+	return &pixels[jobs[thumbnail].firstPixel];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
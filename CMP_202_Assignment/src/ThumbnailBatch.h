@@ -0,0 +1,47 @@
+#pragma once
+#include "ColourPalette.h"
+#include "FractalRegistry.h"
+#include <string>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Renders lots of small images of different parts of the same fractal at once.
+ *
+ * Calling compute_fractal_with_AMP once per thumbnail pays for the palette, a launch and a
+ * synchronize every time, and a 128x128 image isn't enough threads to fill the accelerator.
+ * Here every thumbnail is packed in to one pixel buffer and they all go in a single launch,
+ * so the setup is paid once per batch and the accelerator sees the whole batch as one big job.
+ *
+ * Pixels are 0x00RRGGBB, the same as the image array in Mandlebrot.cpp.
+ */
+class ThumbnailBatch
+{
+public:
+	ThumbnailBatch(const std::string& name);
+	~ThumbnailBatch();
+
+	int addThumbnail(float left, float right, float top, float bottom, int width, int height);
+	void clear();
+
+	bool render();
+	bool renderOneAtATime();
+	bool write_tga(int thumbnail, const char* filename);
+
+	// GETTERS / SETTERS
+	int getNumThumbnails();
+	int getWidth(int thumbnail);
+	int getHeight(int thumbnail);
+	const uint32_t* getPixels(int thumbnail);
+
+private:
+	const FractalVariant* variant;
+
+	std::vector<ThumbnailJob> jobs;
+	std::vector<uint32_t> pixels;	// Every thumbnail one after another, see ThumbnailJob::firstPixel.
+
+	ColourPalette palette;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////